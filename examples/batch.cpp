@@ -0,0 +1,95 @@
+#include "lockedhash.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+struct Flow {
+  uint64_t id;
+  uint64_t packets;
+};
+
+struct FlowHash {
+  size_t operator()(uint64_t id) const noexcept { //
+    return id * 0x9e3779b97f4a7c15ULL;
+  }
+};
+struct FlowMakeKey {
+  uint64_t operator()(Flow const &f) const noexcept { //
+    return f.id;
+  }
+};
+
+using FlowHashTable = LockedHash<uint64_t, Flow, FlowHash, FlowMakeKey>;
+
+/**
+ * @brief ns per lookup of keys, one by one or batch keys at a time
+ * on a table far larger than the last level cache every bucket and node
+ * is a miss; multi_get() has the misses of several keys in flight at once.
+ */
+static double bench(FlowHashTable &hash, const vector<uint64_t> &keys,
+                    size_t batch) {
+  vector<tl::optional<Flow>> out(batch);
+  size_t found = 0;
+  auto begin = chrono::steady_clock::now();
+  if (batch == 1) {
+    for (uint64_t k : keys) {
+      found += hash(k).has_value();
+    }
+  } else {
+    for (size_t i = 0; i + batch <= keys.size(); i += batch) {
+      found += hash.multi_get(&keys[i], batch, out.data());
+    }
+  }
+  double ns =
+      chrono::duration<double, nano>(chrono::steady_clock::now() - begin)
+          .count();
+  if (found != keys.size() / batch * batch) {
+    cerr << "lost keys\n";
+  }
+  return ns / keys.size();
+}
+
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000000;
+  size_t lookups = argc > 2 ? strtoul(argv[2], nullptr, 10) : 10000000;
+
+  FlowHashTable hash(count);
+  for (uint64_t i = 0; i < count; i++) {
+    hash(Flow{i, 0});
+  }
+
+  mt19937_64 rng(1);
+  vector<uint64_t> keys(lookups);
+  for (auto &k : keys) {
+    k = rng() % count;
+  }
+
+  cout << count << " entries, " << lookups << " random lookups, prefetch "
+       << LOCKEDHASH_PREFETCH_DISTANCE << " keys ahead\n";
+  cout << "  one by one:      " << bench(hash, keys, 1) << " ns/key\n";
+  for (size_t batch = 16; batch <= 256; batch *= 4) {
+    cout << "  multi_get(" << batch << "):" << string(batch < 100 ? 3 : 2, ' ')
+         << bench(hash, keys, batch) << " ns/key\n";
+  }
+}
+/*
+benchmark (g++ -O2, 1 core; 20M entries to fit this box, the default
+100M needs ~8GB). prefetch 0: g++ -DLOCKEDHASH_PREFETCH_DISTANCE=0
+
+~/git/LockedHash$ ./build/examples/batch 20000000 4000000
+20000000 entries, 4000000 random lookups, prefetch 8 keys ahead
+  one by one:      618.493 ns/key
+  multi_get(16):   466.435 ns/key
+  multi_get(64):   409.525 ns/key
+  multi_get(256):  401.433 ns/key
+
+20000000 entries, 4000000 random lookups, prefetch 0 keys ahead
+  one by one:      707.436 ns/key
+  multi_get(16):   631.423 ns/key
+  multi_get(64):   627.131 ns/key
+  multi_get(256):  647.836 ns/key
+*/
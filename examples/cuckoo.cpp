@@ -0,0 +1,104 @@
+#include "lockedhash.hpp"
+#include "person.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// bytes held through the allocator (chained: nodes only, not the bucket
+/// array; cuckoo: slot arrays)
+static atomic<size_t> allocated(0);
+
+template <typename _T> struct CountingAllocator {
+  typedef _T value_type;
+  CountingAllocator() {}
+  template <typename _U> CountingAllocator(const CountingAllocator<_U> &) {}
+  _T *allocate(size_t n) {
+    allocated += n * sizeof(_T);
+    return static_cast<_T *>(::operator new(n * sizeof(_T)));
+  }
+  void deallocate(_T *p, size_t n) {
+    allocated -= n * sizeof(_T);
+    ::operator delete(p);
+  }
+  template <typename _U> bool operator==(const CountingAllocator<_U> &) const {
+    return true;
+  }
+  template <typename _U> bool operator!=(const CountingAllocator<_U> &) const {
+    return false;
+  }
+};
+
+template <typename _Storage>
+using PersonHashTable =
+    LockedHash<PersonKey, Person, PersonHash, PersonMakeKey, _Storage,
+               std::equal_to<PersonKey>, PersonHash,
+               CountingAllocator<Person>>;
+
+static double elapsed_ns(chrono::steady_clock::time_point begin, int ops) {
+  return chrono::duration<double, nano>(chrono::steady_clock::now() - begin)
+             .count() /
+         ops;
+}
+
+template <typename _Storage> void bench(const char *name, int datasize) {
+  vector<PersonKey> keys;
+  for (int i = 1; i <= datasize; i++) {
+    keys.push_back(PersonKey("P" + to_string(i), i));
+  }
+  allocated = 0;
+  PersonHashTable<_Storage> hash(datasize, 60);
+
+  auto t = chrono::steady_clock::now();
+  for (auto &k : keys) {
+    hash(Person(k));
+  }
+  double insert_ns = elapsed_ns(t, datasize);
+  size_t bytes = allocated;
+
+  size_t found = 0;
+  t = chrono::steady_clock::now();
+  for (auto &k : keys) {
+    hash.find(k, [&found](Person &p) { found += p.empno() > 0; });
+  }
+  double hit_ns = elapsed_ns(t, datasize);
+
+  t = chrono::steady_clock::now();
+  for (auto &k : keys) {
+    hash.find(PersonKey(k.first, -k.second),
+              [&found](Person &p) { found += p.empno() > 0; });
+  }
+  double miss_ns = elapsed_ns(t, datasize);
+
+  cout << name << " (found " << found << ")\n"
+       << "  insert: " << insert_ns << " ns/op\n"
+       << "  hit   : " << hit_ns << " ns/op\n"
+       << "  miss  : " << miss_ns << " ns/op\n"
+       << "  bytes : " << (double)bytes / datasize << " per entry ("
+       << sizeof(Person) << " of Person)\n";
+}
+
+int main(int argc, char **argv) {
+  int datasize = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  bench<LockedHashChained>("LockedHashChained", datasize);
+  bench<LockedHashCuckoo>("LockedHashCuckoo", datasize);
+}
+/*
+benchmark (g++ -O2, 1 core)
+
+~/git/LockedHash$ ./build/examples/cuckoo 1000000
+LockedHashChained (found 1000000)
+  insert: 691.385 ns/op
+  hit   : 375.824 ns/op
+  miss  : 512.747 ns/op
+  bytes : 80 per entry (48 of Person)
+LockedHashCuckoo (found 1000000)
+  insert: 600.111 ns/op
+  hit   : 354.288 ns/op
+  miss  : 78.8642 ns/op
+  bytes : 70.7052 per entry (48 of Person)
+*/
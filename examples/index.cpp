@@ -0,0 +1,100 @@
+#include "lockedhash.hpp"
+#include "person.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+template <typename _Index>
+using PersonHashTable =
+    LockedHash<PersonKey, Person, PersonHash, PersonMakeKey,
+               LockedHashChainedPolicy<_Index>>;
+
+static double elapsed_ns(chrono::steady_clock::time_point begin, size_t ops) {
+  return chrono::duration<double, nano>(chrono::steady_clock::now() - begin)
+             .count() /
+         ops;
+}
+
+template <typename _Index>
+void bench(const char *name, vector<PersonKey> &keys, size_t bucket_size) {
+  // index computation alone
+  _Index index;
+  index.init(bucket_size);
+  vector<size_t> hashes;
+  PersonHash hasher;
+  for (auto &k : keys) {
+    hashes.push_back(hasher(k));
+  }
+  size_t sum = 0;
+  auto t = chrono::steady_clock::now();
+  for (int round = 0; round < 10; round++) {
+    for (size_t h : hashes) {
+      size_t home, high;
+      index(h + round, home, high);
+      sum += home + high;
+    }
+  }
+  double index_ns = elapsed_ns(t, hashes.size() * 10);
+
+  PersonHashTable<_Index> hash(bucket_size, 60);
+  hash.max_load_factor(0); // fixed bucket count
+  for (auto &k : keys) {
+    hash(Person(k));
+  }
+
+  // longest chain: how well the weak PersonHash is spread
+  size_t longest = 0;
+  for (size_t n : hash.bucket_elements()) {
+    longest = max(longest, n);
+  }
+
+  size_t found = 0;
+  t = chrono::steady_clock::now();
+  for (auto &k : keys) {
+    hash.find(k, [&found](Person &p) { found += p.empno() > 0; });
+  }
+  double hit_ns = elapsed_ns(t, keys.size());
+
+  cout << name << " (buckets " << hash.bucket_count() << ", longest chain "
+       << longest << ", found " << found << ", " << sum % 10 << ")\n"
+       << "  index: " << index_ns << " ns/op\n"
+       << "  hit  : " << hit_ns << " ns/op\n";
+}
+
+int main(int argc, char **argv) {
+  size_t datasize = argc > 1 ? atoi(argv[1]) : 1000000;
+  size_t bucket_size = argc > 2 ? atoi(argv[2]) : 1000003;
+
+  vector<PersonKey> keys;
+  for (size_t i = 1; i <= datasize; i++) {
+    keys.push_back(PersonKey("P" + to_string(i), i));
+  }
+
+  bench<LockedHashIndexModulo>("LockedHashIndexModulo", keys, bucket_size);
+  bench<LockedHashIndexReciprocal>("LockedHashIndexReciprocal", keys,
+                                   bucket_size);
+  bench<LockedHashIndexFastrange>("LockedHashIndexFastrange", keys,
+                                  bucket_size);
+  bench<LockedHashIndexMask>("LockedHashIndexMask", keys, bucket_size);
+}
+/*
+benchmark (g++ -O2, 1 core)
+"index" is the hash -> (home, high) step alone; "hit" is a whole find().
+
+~/git/LockedHash$ ./build/examples/index 1000000 1000003
+LockedHashIndexModulo (buckets 1000003, longest chain 8, found 1000000, 4)
+  index: 4.34168 ns/op
+  hit  : 440.825 ns/op
+LockedHashIndexReciprocal (buckets 1000003, longest chain 8, found 1000000, 4)
+  index: 4.97574 ns/op
+  hit  : 344.886 ns/op
+LockedHashIndexFastrange (buckets 1000003, longest chain 9, found 1000000, 6)
+  index: 1.24878 ns/op
+  hit  : 421.985 ns/op
+LockedHashIndexMask (buckets 1048576, longest chain 8, found 1000000, 4)
+  index: 2.8763 ns/op
+  hit  : 294.166 ns/op
+*/
@@ -1,50 +1,52 @@
 #ifndef __PERSON_SAMPLE_HPP__
 #define __PERSON_SAMPLE_HPP__
 
+#include "lockedhash_hash.hpp"
 #include <string>
 
 using PersonKey = std::pair<std::string, int>;
 
 class Person {
 private:
-  std::string _name;
-  int _empno = 0;
+  PersonKey _key = PersonKey("", 0);
   int _cache = 0;
   int _data = 0;
 
 public:
   Person() {}
-  Person(const PersonKey &k) : Person() {
-    _name = k.first;
-    _empno = k.second;
-  }
+  Person(const PersonKey &k) : Person() { _key = k; }
   Person(const std::string &name, int empno) : Person() {
-    _name = name;
-    _empno = empno;
+    _key = PersonKey(name, empno);
   }
-  const std::string name() const { return _name; }
-  void setName(const std::string name) { _name = name; }
-  int empno() const { return _empno; }
-  void setEmpno(int empno) { _empno = empno; }
+  const PersonKey &key() const { return _key; }
+  const std::string name() const { return _key.first; }
+  void setName(const std::string name) { _key.first = name; }
+  int empno() const { return _key.second; }
+  void setEmpno(int empno) { _key.second = empno; }
   void hit() { _cache++; }
   void setData(int data) { _data = data; }
   int data() { return _data; }
 
   std::string to_string() {
-    return "name: " + _name + ", empno: " + std::to_string(_empno) +
+    return "name: " + _key.first + ", empno: " + std::to_string(_key.second) +
            ", cache: " + std::to_string(_cache) +
            ", data: " + std::to_string(_data);
   }
 };
 
 struct PersonHash {
-  size_t operator()(Person const &p) const noexcept {
-    return std::hash<std::string>{}(p.name()) + p.empno();
+  /// LockedHash hashes keys: no Person is built from the PersonKey.
+  /// sequential empnos of one name spread over the buckets
+  size_t operator()(PersonKey const &k) const noexcept {
+    return LockedHashTupleHash()(k);
+  }
+  size_t operator()(Person const &p) const noexcept { //
+    return operator()(p.key());
   }
 };
 struct PersonMakeKey {
-  PersonKey operator()(Person const &p) const noexcept {
-    return PersonKey(p.name(), p.empno());
+  const PersonKey &operator()(Person const &p) const noexcept { //
+    return p.key();
   }
 };
 
@@ -0,0 +1,69 @@
+#include "lockedhash.hpp"
+#include "person.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+using PersonHashTable =
+    LockedHash<PersonKey, Person, PersonHash, PersonMakeKey>;
+
+/**
+ * @brief threads insert and remove their own keys (no bucket is shared on
+ * purpose), so what is left to contend on is the table itself.
+ */
+static double bench(int threads, int ops) {
+  PersonHashTable hash(1 << 20);
+  vector<vector<PersonKey>> keys(threads);
+  for (int t = 0; t < threads; t++) {
+    for (int i = 0; i < 1024; i++) {
+      keys[t].push_back(PersonKey("T" + to_string(t), i));
+    }
+  }
+
+  auto begin = chrono::steady_clock::now();
+  vector<thread> vs;
+  for (int t = 0; t < threads; t++) {
+    vs.push_back(thread([&hash, &keys, t, ops]() {
+      for (int n = 0; n < ops; n += 2) {
+        PersonKey &k = keys[t][(n / 2) % keys[t].size()];
+        hash(Person(k));
+        hash.rm(k);
+      }
+    }));
+  }
+  for (auto &t : vs) {
+    t.join();
+  }
+  double sec =
+      chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+  return (double)threads * ops / sec / 1e6;
+}
+
+int main(int argc, char **argv) {
+  int ops = argc > 1 ? atoi(argv[1]) : 1000000;
+  int max_threads = argc > 2 ? atoi(argv[2]) : 64;
+
+  cout << "insert + rm on disjoint keys, " << ops << " ops per thread ("
+       << thread::hardware_concurrency() << " cores)\n";
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    cout << "  " << threads << " threads: " << bench(threads, ops)
+         << " Mops/s\n";
+  }
+}
+/*
+benchmark (g++ -O2, 1 core: shows the overhead, not the scaling)
+
+~/git/LockedHash$ ./build/examples/scaling 200000 64
+insert + rm on disjoint keys, 200000 ops per thread (1 cores)
+  1 threads: 7.43276 Mops/s
+  2 threads: 7.34879 Mops/s
+  4 threads: 8.06808 Mops/s
+  8 threads: 8.39886 Mops/s
+  16 threads: 8.55696 Mops/s
+  32 threads: 10.182 Mops/s
+  64 threads: 11.3785 Mops/s
+*/
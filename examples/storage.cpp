@@ -0,0 +1,95 @@
+#include "lockedhash.hpp"
+#include "person.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+template <typename _Storage, typename _Alloc>
+using PersonHashTable =
+    LockedHash<PersonKey, Person, PersonHash, PersonMakeKey, _Storage,
+               std::equal_to<PersonKey>, PersonHash, _Alloc>;
+
+static double elapsed_ns(chrono::steady_clock::time_point begin, int ops) {
+  return chrono::duration<double, nano>(chrono::steady_clock::now() - begin)
+             .count() /
+         ops;
+}
+
+template <typename _Storage, typename _Alloc = std::allocator<Person>>
+void bench(const char *name, int datasize) {
+  vector<PersonKey> keys;
+  for (int i = 1; i <= datasize; i++) {
+    keys.push_back(PersonKey("P" + to_string(i), i));
+  }
+  PersonHashTable<_Storage, _Alloc> hash(datasize, 60);
+
+  auto t = chrono::steady_clock::now();
+  for (auto &k : keys) {
+    hash(Person(k));
+  }
+  double insert_ns = elapsed_ns(t, datasize);
+
+  size_t found = 0;
+  t = chrono::steady_clock::now();
+  for (auto &k : keys) {
+    hash.find(k, [&found](Person &p) { found += p.empno() > 0; });
+  }
+  double hit_ns = elapsed_ns(t, datasize);
+
+  t = chrono::steady_clock::now();
+  for (auto &k : keys) {
+    hash.find(PersonKey(k.first, -k.second),
+              [&found](Person &p) { found += p.empno() > 0; });
+  }
+  double miss_ns = elapsed_ns(t, datasize);
+
+  t = chrono::steady_clock::now();
+  for (auto &k : keys) {
+    hash.rm(k);
+  }
+  double rm_ns = elapsed_ns(t, datasize);
+
+  cout << name << " (found " << found << ")\n"
+       << "  insert: " << insert_ns << " ns/op\n"
+       << "  hit   : " << hit_ns << " ns/op\n"
+       << "  miss  : " << miss_ns << " ns/op\n"
+       << "  rm    : " << rm_ns << " ns/op\n";
+}
+
+int main(int argc, char **argv) {
+  int datasize = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  bench<LockedHashChained>("LockedHashChained", datasize);
+  bench<LockedHashChained, LockedHashSlabAllocator<Person>>(
+      "LockedHashChained + LockedHashSlabAllocator", datasize);
+  bench<LockedHashSwiss>("LockedHashSwiss", datasize);
+  bench<LockedHashSplitOrdered>("LockedHashSplitOrdered", datasize);
+}
+/*
+benchmark (g++ -O2, 1 core)
+
+~/git/LockedHash$ ./build/examples/storage 1000000
+LockedHashChained (found 1000000)
+  insert: 724.067 ns/op
+  hit   : 319.816 ns/op
+  miss  : 581.618 ns/op
+  rm    : 524.45 ns/op
+LockedHashChained + LockedHashSlabAllocator (found 1000000)
+  insert: 583.595 ns/op
+  hit   : 375.282 ns/op
+  miss  : 469.629 ns/op
+  rm    : 531.51 ns/op
+LockedHashSwiss (found 1000000)
+  insert: 782.226 ns/op
+  hit   : 546.144 ns/op
+  miss  : 229.77 ns/op
+  rm    : 580.181 ns/op
+LockedHashSplitOrdered (found 1000000)
+  insert: 1420.47 ns/op
+  hit   : 738.97 ns/op
+  miss  : 1061.7 ns/op
+  rm    : 1071.98 ns/op
+*/
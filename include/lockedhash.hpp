@@ -1,12 +1,20 @@
 #ifndef __LOCKED_HASH_HPP__
 #define __LOCKED_HASH_HPP__
 
+#include <algorithm>
 #include <assert.h>
 #include <atomic>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <list>
+#include <lockedhash_base.hpp>
+#include <lockedhash_cuckoo.hpp>
+#include <lockedhash_epoch.hpp>
+#include <lockedhash_lock.hpp>
+#include <lockedhash_slab.hpp>
+#include <lockedhash_splitordered.hpp>
+#include <lockedhash_swiss.hpp>
 #include <mutex>
 #include <optional.hpp>
 #include <pthread.h>
@@ -16,19 +24,51 @@
 #include <time.h>
 #include <vector>
 
+/// maximum number of bucket doublings (segments) of a LockedHash
+#define LOCKEDHASH_MAX_LEVEL 48
+/// buckets split or merged by each insert / remove when out of load range
+#define LOCKEDHASH_REHASH_STEPS 2
+
 /**
- * @brief LockedHash
+ * @brief LockedHash (LockedHashChained storage)
+ *
+ * The bucket array grows and shrinks by linear hashing: one bucket is split
+ * (or merged) at a time, so no call ever rehashes the whole table.
+ * Bucket locks (stripes) are fixed at construction; a key always maps to
+ * the same stripe (of its home bucket) whatever the current bucket count
+ * is.
+ * _Storage::index_type maps a hash to its home bucket (hash % bucket_size
+ * by default).
  *
  * @tparam _Key      Type of key objects.
  * @tparam _Tp       Type of mapped objects.
  * @tparam _Hash     Hashing function object type
  * @tparam _MakeKey  Make Key function object type
+ * @tparam _Storage  LockedHashChainedPolicy<_Index>
+ * @tparam _KeyEqual Key equality function object type
+ * @tparam _KeyHash  Key hashing function object type
+ * @tparam _Alloc    Allocator type (rebound to LockedHashNode)
  */
-template <typename _Key, typename _Tp, typename _Hash, typename _MakeKey> //
-class LockedHash {
+template <typename _Key, typename _Tp, typename _Hash, typename _MakeKey,
+          typename _Storage, typename _KeyEqual, typename _KeyHash,
+          typename _Alloc>
+class LockedHash
+    : public LockedHashBase<LockedHash<_Key, _Tp, _Hash, _MakeKey, _Storage,
+                                       _KeyEqual, _KeyHash, _Alloc>,
+                            _Key, _Tp, _MakeKey, _KeyEqual, _KeyHash> {
+private:
+  typedef LockedHashBase<LockedHash, _Key, _Tp, _MakeKey, _KeyEqual, _KeyHash>
+      _Base;
+  friend _Base;
+  using _Base::_hash;
+  using _Base::_makekey;
+  using _Base::_keyequal;
+
 private:
   /**
    * @brief LockedHashNode
+   * _hashcode (full hash of the key) is compared before the key itself,
+   * so a chain walk calls _makekey only on a hash match.
    *
    * @tparam _Tp Type of Object
    */
@@ -37,65 +77,583 @@ private:
     LockedHashNode *prev, *next;
     _Tp _tp;
     time_t _timestamp = time(nullptr);
+    size_t _hashcode = 0;
+
+    template <typename... _Args>
+    LockedHashNode(_Args &&...args)
+        : prev(NULL), next(NULL), _tp(std::forward<_Args>(args)...) {}
+  };
+
+  typedef typename std::allocator_traits<_Alloc>::template rebind_alloc<
+      LockedHashNode>
+      _NodeAlloc;
+  typedef std::allocator_traits<_NodeAlloc> _NodeTraits;
+  typedef typename _Storage::index_type _Index;
+  typedef typename _Storage::lock_type _Lock;
+  /// how searches read: under the lock, seqlock-validated, or in an epoch
+  typedef std::integral_constant<int, 0> _ReadLocked;
+  typedef std::integral_constant<int, 1> _ReadSeq;
+  typedef std::integral_constant<int, 2> _ReadEpoch;
+  typedef std::integral_constant<int, _Lock::optimistic ? 1
+                                      : _Lock::epoch    ? 2
+                                                        : 0>
+      _ReadMode;
+
+  static_assert(!_Lock::optimistic || std::is_trivially_copyable<_Tp>::value,
+                "optimistic reads (LockedHashSeqLock) copy _Tp bytewise: "
+                "_Tp must be trivially copyable");
+  static_assert(!_Lock::optimistic || LockedHashIsTypeStable<_NodeAlloc>::value,
+                "optimistic reads (LockedHashSeqLock) may read freed nodes: "
+                "use a type-stable allocator (LockedHashSlabAllocator)");
+
+  /**
+   * @brief LockedHashBucket
+   *
+   */
+  class LockedHashBucket {
+  public:
+    /// chain head
+    LockedHashNode *head = nullptr;
+    /// element number of this bucket (changed under the bucket lock)
+    size_t elements = 0;
+    /// fingerprints (_tag) of up to 8 nodes of the chain, a byte each, 0
+    /// if free. while they cover all elements, a key whose fingerprint is
+    /// not there is missed without walking the chain.
+    uint64_t tags = 0;
+  };
+
+  /**
+   * @brief LockedHashHeader
+   * bucket lock and the home bucket of the same index, on one cache line
+   * (LockedHashRecursiveLock: 40 + 24 bytes): a call on a home bucket
+   * takes its lock and reads its chain head with a single miss.
+   * home buckets past the stripes, and split buckets, live in _segments.
+   */
+  class LockedHashHeader {
+  public:
+    _Lock lock;
+    LockedHashBucket bucket;
+  };
+
+  /**
+   * @brief nodes removed under a stripe lock, waiting for their epoch
+   * (LockedHashEpochLock)
+   */
+  class LockedHashRetired {
+  public:
+    std::vector<std::pair<uint64_t, LockedHashNode *>> nodes;
+  };
+
+  /**
+   * @brief bucket lock guard (exclusive, or shared for reads)
+   * counts the bucket locks held by this thread, so that nested calls
+   * from a callback never split/merge a bucket under an ongoing walk.
+   */
+  class LockedHashGuard {
+  private:
+    _Lock *_lock;
+    bool _shared;
 
-    LockedHashNode() { prev = next = NULL; }
-    LockedHashNode(_Tp &tp) : LockedHashNode() { _tp = tp; }
-    LockedHashNode(_Tp &&tp) : LockedHashNode(tp) {}
+  public:
+    /// holds nothing
+    LockedHashGuard() : _lock(nullptr), _shared(true) {}
+    LockedHashGuard(_Lock &lock, bool shared = false)
+        : _lock(&lock), _shared(shared) {
+      if (_shared) {
+        _lock->lock_shared();
+      } else {
+        _lock->lock();
+      }
+      _lock_depth()++;
+    }
+    LockedHashGuard(LockedHashGuard &&o) : _lock(o._lock), _shared(o._shared) {
+      o._lock = nullptr;
+    }
+    ~LockedHashGuard() { //
+      release();
+    }
+
+    void release() {
+      if (_lock == nullptr) {
+        return;
+      }
+      _lock_depth()--;
+      if (_shared) {
+        _lock->unlock_shared();
+      } else {
+        _lock->unlock();
+      }
+      _lock = nullptr;
+    }
   };
 
+public:
+  /// value in place, bucket lock held (access)
+  typedef LockedHashAccessor<_Tp, LockedHashGuard> accessor;
+  /// read-only value in place, bucket lock held shared (access_shared)
+  typedef LockedHashAccessor<const _Tp, LockedHashGuard> const_accessor;
+
 private:
-  /// bucket locks
-  std::recursive_mutex *_bucket_locks;
-  /// element number for each bucket
-  std::atomic<size_t> *_bucket_elements;
-  /// bucket array
-  LockedHashNode **_buckets;
+  /// node allocator
+  _NodeAlloc _alloc;
+  /// bucket locks (stripe of home bucket: home & (stripes - 1))
+  LockedHashStripes<LockedHashHeader> _stripes;
+  /// stripes that own a home bucket (min(_stripes.size(), _bucket_size))
+  size_t _stripe_count;
+  /// retired nodes of each stripe (LockedHashEpochLock)
+  LockedHashStripes<LockedHashRetired> _retired;
+  /// bucket segments
+  /// [0] initial buckets, [k] buckets added by the k-th doubling
+  LockedHashBucket *_segments[LOCKEDHASH_MAX_LEVEL + 1];
   /// total elements
-  std::atomic<std::size_t> _size;
-  /// fixed bucket size
+  LockedHashCounter _size;
+  /// hash -> home bucket
+  _Index _index;
+  /// initial bucket size (number of home buckets)
   size_t _bucket_size;
-  /// hash function
-  _Hash _hash;
-  /// make key function
-  _MakeKey _makekey;
+  /// floor(log2(_bucket_size))
+  size_t _bucket_size_log2;
+  /// linear hashing state (level << 56 | split)
+  std::atomic<size_t> _split_state;
+  /// serializes split/merge steps
+  std::mutex _resize_lock;
+  /// odd while a split/merge moves nodes (lock-free misses are retried)
+  std::atomic<size_t> _resize_seq{0};
+  /// grow when size() > bucket_count() * _max_load_factor (0: never)
+  double _max_load_factor = 1.0;
+  /// shrink when size() < bucket_count() * _min_load_factor (0: never)
+  double _min_load_factor = 0.25;
 
   time_t _expire_time = 0;
 
+  static const size_t SPLIT_SHIFT = 56;
+  static const size_t SPLIT_MASK = (1UL << SPLIT_SHIFT) - 1;
+
 private:
-  std::recursive_mutex &_get_bucket_lock(_Key key) {
-    return _bucket_locks[_hash(key) % _bucket_size];
+  static size_t &_lock_depth() {
+    static thread_local size_t depth = 0;
+    return depth;
+  }
+
+  template <typename... _Args> LockedHashNode *_new_node(_Args &&...args) {
+    LockedHashNode *c = _NodeTraits::allocate(_alloc, 1);
+    try {
+      _NodeTraits::construct(_alloc, c, std::forward<_Args>(args)...);
+    } catch (...) {
+      _NodeTraits::deallocate(_alloc, c, 1);
+      throw;
+    }
+    return c;
+  }
+
+  void _delete_node(LockedHashNode *c) {
+    _NodeTraits::destroy(_alloc, c);
+    _NodeTraits::deallocate(_alloc, c, 1);
+  }
+
+  /// free unlinked nodes, at once if the allocator can (deallocate_bulk)
+  void _delete_nodes(std::vector<LockedHashNode *> &nodes) {
+    for (LockedHashNode *c : nodes) {
+      _NodeTraits::destroy(_alloc, c);
+    }
+    _deallocate_nodes(nodes, LockedHashHasBulkFree<_NodeAlloc>());
+    nodes.clear();
+  }
+
+  void _deallocate_nodes(std::vector<LockedHashNode *> &nodes,
+                         std::true_type) {
+    _alloc.deallocate_bulk(nodes.data(), nodes.size());
+  }
+
+  void _deallocate_nodes(std::vector<LockedHashNode *> &nodes,
+                         std::false_type) {
+    for (LockedHashNode *c : nodes) {
+      _NodeTraits::deallocate(_alloc, c, 1);
+    }
+  }
+
+  /// true if destroying _alloc frees every node (see ~LockedHash)
+  bool _released_on_destroy(std::true_type) { //
+    return _alloc.unique();
+  }
+
+  bool _released_on_destroy(std::false_type) { //
+    return false;
+  }
+
+  /**
+   * @brief free a node unlinked under the lock of stripe s; with
+   * LockedHashEpochLock, retire it until no reader can see it.
+   */
+  void _dispose(size_t s, LockedHashNode *c) { //
+    _dispose(s, c, _ReadMode());
+  }
+
+  /**
+   * @brief the value of a node that is being removed, to move from; with
+   * LockedHashEpochLock readers may still see the node, so it is copied
+   */
+  typename std::conditional<_ReadMode::value == _ReadEpoch::value,
+                            const _Tp &, _Tp &&>::type
+  _move_out(LockedHashNode *c) {
+    return std::move(c->_tp);
+  }
+
+  template <typename _Mode> void _dispose(size_t, LockedHashNode *c, _Mode) {
+    _delete_node(c);
+  }
+
+  void _dispose(size_t s, LockedHashNode *c, _ReadEpoch) {
+    LockedHashRetired &r = _retired.of(s);
+    r.nodes.push_back(std::make_pair(LockedHashEpoch::instance().current(), c));
+    if (r.nodes.size() >= LOCKEDHASH_EPOCH_RECLAIM) {
+      _reclaim(r);
+    }
+  }
+
+  /// free retired nodes that no reader can see anymore
+  void _reclaim(LockedHashRetired &r) {
+    uint64_t safe = LockedHashEpoch::instance().reclaimable();
+    std::vector<LockedHashNode *> nodes;
+    size_t keep = 0;
+    for (auto &n : r.nodes) {
+      if (n.first < safe) {
+        nodes.push_back(n.second);
+      } else {
+        r.nodes[keep++] = n;
+      }
+    }
+    r.nodes.resize(keep);
+    _delete_nodes(nodes);
+  }
+
+  static LockedHashNode *_load(LockedHashNode *const &p) {
+    return __atomic_load_n(&p, __ATOMIC_ACQUIRE);
+  }
+
+  /// chain pointers are stored with release (lock-free readers)
+  static void _store(LockedHashNode *&p, LockedHashNode *v) {
+    __atomic_store_n(&p, v, __ATOMIC_RELEASE);
+  }
+
+  static size_t _log2(size_t n) { //
+    return 63 - __builtin_clzl(n);
+  }
+
+  static size_t _stripes_for(size_t bucket_size, size_t lock_stripes) {
+    if (lock_stripes == 0) {
+      lock_stripes = LOCKEDHASH_LOCK_STRIPES;
+    }
+    return lock_stripes < bucket_size ? lock_stripes : bucket_size;
+  }
+
+  /// bucket lock of a home bucket
+  _Lock &_get_home_lock(size_t home) { //
+    return _stripes.of(home).lock;
+  }
+
+  /// bucket lock of a bucket index
+  _Lock &_get_bucket_lock(size_t bucket) {
+    return _stripes.of(bucket % _bucket_size).lock;
+  }
+
+  /**
+   * @brief next bucket of stripe s after bucket i
+   * walks home buckets s, s + stripes, ... then the same homes one
+   * _bucket_size row up; so every bucket of the stripe comes once, in
+   * increasing order.
+   */
+  size_t _next_bucket(size_t i, size_t s) {
+    size_t home = i % _bucket_size;
+    if (home + _stripes.size() < _bucket_size) {
+      return i + _stripes.size();
+    }
+    return i - home + _bucket_size + s;
+  }
+
+  /**
+   * @brief bucket index of home/high under linear hashing state
+   * home + _bucket_size * (high % 2^level), or one level up if already
+   * split. must be called with the bucket lock of home held.
+   */
+  size_t _get_bucket_index(size_t home, size_t high, size_t state) {
+    size_t level = state >> SPLIT_SHIFT;
+    size_t split = state & SPLIT_MASK;
+    size_t bucket = home + _bucket_size * (high & ((1UL << level) - 1));
+    if (bucket < split) {
+      bucket = home + _bucket_size * (high & ((2UL << level) - 1));
+    }
+    return bucket;
+  }
+
+  size_t _get_bucket_index(size_t hash, size_t state) {
+    size_t home, high;
+    _index(hash, home, high);
+    return _get_bucket_index(home, high, state);
+  }
+
+  LockedHashBucket &_get_bucket(size_t bucket) {
+    if (bucket < _stripe_count) {
+      return _stripes[bucket].bucket;
+    }
+    if (bucket < _bucket_size) {
+      return _segments[0][bucket - _stripe_count];
+    }
+    size_t k = _log2(bucket) - _bucket_size_log2;
+    if (bucket >= (_bucket_size << k)) {
+      k++;
+    }
+    return _segments[k][bucket - (_bucket_size << (k - 1))];
+  }
+
+  /// fingerprint of a hash, never 0 (remixed: small integer hashes have
+  /// an empty top byte)
+  static uint8_t _tag(size_t hash) {
+    uint8_t tag = (uint8_t)((hash * LockedHashFmix::K) >> 56);
+    return tag ? tag : 1;
+  }
+
+  /**
+   * @brief bytes of tags equal to tag, in one compare (SWAR)
+   * the high bit of the lowest such byte is set (bytes above it may be
+   * flagged wrongly); 0 if there is none.
+   */
+  static uint64_t _match(uint64_t tags, uint8_t tag) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    uint64_t x = tags ^ (ones * tag);
+    return (x - ones) & ~x & (ones << 7);
+  }
+
+  /// first node to walk for hash: nullptr if the fingerprints of bk rule
+  /// it out (bucket lock held)
+  LockedHashNode *_chain(LockedHashBucket &bk, size_t hash) {
+    if (bk.elements <= 8 && _match(bk.tags, _tag(hash)) == 0) {
+      return nullptr;
+    }
+    return bk.head;
+  }
+
+  /// fingerprints of the first 8 nodes of bk
+  void _retag(LockedHashBucket &bk) {
+    bk.tags = 0;
+    LockedHashNode *c = bk.head;
+    for (size_t shift = 0; c && shift < 64; shift += 8, c = c->next) {
+      bk.tags |= (uint64_t)_tag(c->_hashcode) << shift;
+    }
+  }
+
+  void _unlink(LockedHashBucket &bk, LockedHashNode *c) {
+    if (c == bk.head) {
+      _store(bk.head, c->next);
+    } else {
+      _store(c->prev->next, c->next);
+    }
+    if (c->next) {
+      c->next->prev = c->prev;
+    }
+    uint64_t m = _match(bk.tags, _tag(c->_hashcode));
+    if (m == 0) {
+      // c had no free byte (a chain of more than 8)
+      return;
+    }
+    if (_match(bk.tags, 0) == 0) {
+      // full: an untracked node may take the byte (or c was untracked,
+      // and the byte is another node's)
+      _retag(bk);
+    } else {
+      bk.tags &= ~((uint64_t)0xff << (__builtin_ctzll(m) & ~7));
+    }
+  }
+
+  void _link(LockedHashBucket &bk, LockedHashNode *c) {
+    c->prev = NULL;
+    _store(c->next, bk.head);
+    _store(bk.head, c);
+    if (c->next) {
+      c->next->prev = c;
+    }
+    uint64_t m = _match(bk.tags, 0);
+    if (m) {
+      bk.tags |= (uint64_t)_tag(c->_hashcode) << (__builtin_ctzll(m) & ~7);
+    }
+  }
+
+  /// put n (not linked yet) in the place of c
+  void _replace(LockedHashBucket &bk, LockedHashNode *c, LockedHashNode *n) {
+    n->prev = c->prev;
+    _store(n->next, c->next);
+    if (c->next) {
+      c->next->prev = n;
+    }
+    if (c == bk.head) {
+      _store(bk.head, n);
+    } else {
+      _store(c->prev->next, n);
+    }
+  }
+
+  /// true if c is still on the chain of bk
+  bool _linked(LockedHashBucket &bk, LockedHashNode *c) {
+    for (LockedHashNode *n = bk.head; n; n = n->next) {
+      if (n == c) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief split the bucket at the split pointer into a new bucket
+   *
+   * @return true
+   * @return false table is at LOCKEDHASH_MAX_LEVEL
+   */
+  bool _split() {
+    size_t state = _split_state.load();
+    size_t level = state >> SPLIT_SHIFT;
+    size_t split = state & SPLIT_MASK;
+    size_t n = _bucket_size << level;
+    if (level + 1 >= LOCKEDHASH_MAX_LEVEL || n > (SPLIT_MASK >> 1)) {
+      return false;
+    }
+    if (_segments[level + 1] == nullptr) {
+      _segments[level + 1] = new LockedHashBucket[n];
+    }
+
+    LockedHashGuard guard(_get_bucket_lock(split));
+    _resize_seq.fetch_add(1);
+    LockedHashBucket &from = _get_bucket(split);
+    LockedHashBucket &to = _segments[level + 1][split];
+    size_t next_state = (split + 1 == n) ? (level + 1) << SPLIT_SHIFT
+                                         : (level << SPLIT_SHIFT) | (split + 1);
+    LockedHashNode *c = from.head;
+    LockedHashNode *tmp;
+    while (c) {
+      tmp = c->next;
+      if (_get_bucket_index(c->_hashcode, next_state) != split) {
+        _unlink(from, c);
+        _link(to, c);
+        from.elements--;
+        to.elements++;
+      }
+      c = tmp;
+    }
+    _split_state.store(next_state);
+    _resize_seq.fetch_add(1);
+    return true;
+  }
+
+  /**
+   * @brief merge the last bucket back into its split origin
+   *
+   * @return true
+   * @return false table is at its initial bucket size
+   */
+  bool _merge() {
+    size_t state = _split_state.load();
+    size_t level = state >> SPLIT_SHIFT;
+    size_t split = state & SPLIT_MASK;
+    if (level == 0 && split == 0) {
+      return false;
+    }
+    if (split == 0) {
+      level--;
+      split = _bucket_size << level;
+    }
+    split--;
+
+    LockedHashGuard guard(_get_bucket_lock(split));
+    _resize_seq.fetch_add(1);
+    LockedHashBucket &from = _segments[level + 1][split];
+    LockedHashBucket &to = _get_bucket(split);
+    LockedHashNode *c = from.head;
+    LockedHashNode *tmp;
+    while (c) {
+      tmp = c->next;
+      _unlink(from, c);
+      _link(to, c);
+      from.elements--;
+      to.elements++;
+      c = tmp;
+    }
+    _split_state.store((level << SPLIT_SHIFT) | split);
+    _resize_seq.fetch_add(1);
+    return true;
+  }
+
+  /// lock stripe of hash (_Base::_batch)
+  size_t _stripe(size_t hash) {
+    size_t home, high;
+    _index(hash, home, high);
+    return home & (_stripes.size() - 1);
   }
 
-  std::recursive_mutex &_get_bucket_lock(_Tp &tp) {
-    return _get_bucket_lock(_makekey(tp));
+  /// bucket lock of the stripe of hash; lock-free reads take none
+  LockedHashGuard _lock_stripe(size_t hash, bool shared) {
+    if (shared && _ReadMode::value != _ReadLocked::value) {
+      return LockedHashGuard();
+    }
+    size_t home, high;
+    _index(hash, home, high);
+    return LockedHashGuard(_get_home_lock(home), shared);
   }
 
-  std::recursive_mutex &_get_bucket_lock(size_t bucket) {
-    return _bucket_locks[bucket % _bucket_size];
+  /// splits/merges put off while the stripe was held
+  void _batch_end() { //
+    _rehash();
   }
 
-  size_t _get_bucket_index(_Tp &tp) { //
-    return _get_bucket_index(_makekey(tp));
+  /// bucket of hash, then its first node (read racily: only prefetched)
+  void _prefetch(size_t hash, int stage) {
+    size_t home, high;
+    _index(hash, home, high);
+    LockedHashBucket &bk =
+        _get_bucket(_get_bucket_index(home, high, _split_state.load()));
+    if (stage == 0) {
+      LOCKEDHASH_PREFETCH(&bk);
+    } else {
+      LOCKEDHASH_PREFETCH(LockedHashRacy::load(bk.head));
+    }
   }
 
-  size_t _get_bucket_index(_Key key) { //
-    return (_hash(key) % _bucket_size);
+  /**
+   * @brief split/merge a few buckets if load factor is out of range
+   */
+  void _rehash() {
+    size_t count = bucket_count();
+    size_t total = _size.load_relaxed();
+    if ((_max_load_factor > 0 && total > count * _max_load_factor) ||
+        (_min_load_factor > 0 && count > _bucket_size &&
+         total < count * _min_load_factor)) {
+      rehash_step(LOCKEDHASH_REHASH_STEPS);
+    }
   }
 
 public:
   /**
    * @brief Construct a new LockedHash<_Key, _Tp, _Hash, _MakeKey> object
    *
-   * @param bucket_size  fixed bucket size
-   */
-  LockedHash<_Key, _Tp, _Hash, _MakeKey>(size_t bucket_size,
-                                         time_t expire_time) {
-    _bucket_size = bucket_size;
-    _bucket_locks = new std::recursive_mutex[_bucket_size];
-    _bucket_elements =
-        new std::atomic<size_t>[_bucket_size] { ATOMIC_VAR_INIT(0) };
-    _buckets = new LockedHashNode *[_bucket_size] { nullptr, };
-    _size = 0; /// atomic
+   * @param bucket_size   initial bucket size,
+   *                      rounded up to 2^n by LockedHashIndexMask
+   * @param expire_time   expire time (0: never expire)
+   * @param lock_stripes  number of bucket locks, rounded up to 2^n
+   *                      (0: min(bucket_size, LOCKEDHASH_LOCK_STRIPES))
+   * @param alloc         node allocator
+   */
+  LockedHash(size_t bucket_size, time_t expire_time = 0,
+             size_t lock_stripes = 0, const _Alloc &alloc = _Alloc())
+      : _alloc(alloc), _stripes(_stripes_for(bucket_size, lock_stripes)),
+        _retired(_ReadMode::value == _ReadEpoch::value ? _stripes.size() : 1) {
+    assert(bucket_size > 0);
+    _bucket_size = _index.init(bucket_size);
+    _bucket_size_log2 = _log2(_bucket_size);
+    _stripe_count = std::min(_stripes.size(), _bucket_size);
+    for (size_t i = 0; i <= LOCKEDHASH_MAX_LEVEL; i++) {
+      _segments[i] = nullptr;
+    }
+    // home buckets 0 ~ _stripe_count - 1 are in their stripe header
+    _segments[0] = new LockedHashBucket[_bucket_size - _stripe_count];
+    _split_state = 0;
     _expire_time = expire_time;
   }
 
@@ -104,19 +662,38 @@ public:
    *
    */
   virtual ~LockedHash() {
-    delete[] _bucket_locks;
-    delete[] _bucket_elements;
+    // no reader is left: retired nodes go at once
+    for (size_t s = 0; s < _retired.size(); s++) {
+      std::vector<LockedHashNode *> nodes;
+      for (auto &n : _retired[s].nodes) {
+        nodes.push_back(n.second);
+      }
+      _delete_nodes(nodes);
+    }
 
-    LockedHashNode *c, *n;
-    for (size_t i = 0; i < _bucket_size; i++) {
-      c = _buckets[i];
-      while (c) {
-        n = c->next;
-        delete c;
-        c = n;
+    // the last copy of a releasing allocator frees the nodes on its own
+    bool released = _released_on_destroy(
+        LockedHashReleasesOnDestroy<_NodeAlloc>());
+    if (!released ||
+        !std::is_trivially_destructible<LockedHashNode>::value) {
+      LockedHashNode *c, *n;
+      size_t count = bucket_count();
+      for (size_t i = 0; i < count; i++) {
+        c = _get_bucket(i).head;
+        while (c) {
+          n = c->next;
+          if (released) {
+            _NodeTraits::destroy(_alloc, c);
+          } else {
+            _delete_node(c);
+          }
+          c = n;
+        }
       }
     }
-    delete[] _buckets;
+    for (size_t i = 0; i <= LOCKEDHASH_MAX_LEVEL; i++) {
+      delete[] _segments[i];
+    }
   }
 
   /**
@@ -129,118 +706,388 @@ public:
   }
 
   /**
-   * @brief search data (lvalue)
+   * @brief total element size, without reading the counters of the other
+   * threads (LockedHashCounter::load_relaxed)
    *
-   * @param key
-   * @return tl::optional<_Tp>
+   * @return size_t
    */
-  tl::optional<_Tp> operator()(_Key key) {
-    return operator()(key, tl::nullopt);
+  size_t size_relaxed() { //
+    return _size.load_relaxed();
   }
 
   /**
-   * @brief search data (lvalue)
+   * @brief node allocator
+   * ex) get_allocator().slab_count() with LockedHashSlabAllocator
    *
-   * @param key
-   * @return tl::optional<_Tp>
+   * @return const allocator rebound to the node
    */
-  tl::optional<_Tp> operator[](_Key &key) { //
-    return operator[](std::move(key));
+  const _NodeAlloc &get_allocator() const { //
+    return _alloc;
   }
 
   /**
-   * @brief search data (rvalue)
+   * @brief number of bucket locks
    *
-   * @param key
-   * @return tl::optional<_Tp>
+   * @return size_t
    */
-  tl::optional<_Tp> operator[](_Key &&key) { //
-    return operator()(key);
+  size_t lock_stripes() { //
+    return _stripes.size();
   }
 
   /**
-   * @brief update data
+   * @brief current bucket number
    *
-   * @param key
-   * @param interceptor
-   * @return tl::optional<_Tp>
+   * @return size_t
    */
-  tl::optional<_Tp> operator()(_Key key, //
-                               std::function<void(_Tp &)> interceptor) {
-    return operator()(key, operator[](key), interceptor);
+  size_t bucket_count() {
+    size_t state = _split_state.load();
+    return (_bucket_size << (state >> SPLIT_SHIFT)) + (state & SPLIT_MASK);
   }
 
   /**
-   * @brief insert data
+   * @brief average elements per bucket
    *
-   * @param key
-   * @param tp
-   * @return tl::optional<_Tp>
+   * @return double
    */
-  tl::optional<_Tp> operator()(_Key key, _Tp &tp) {
-    return operator()(key, tl::make_optional<_Tp>(tp));
+  double load_factor() { //
+    return (double)size() / bucket_count();
   }
 
   /**
-   * @brief insert or update data (Lvalue)
+   * @brief grow threshold (0: never grow)
+   * set before the table is shared between threads.
    *
-   * @param tp
-   * @param interceptor
-   * @return tl::optional<_Tp>
+   * @param lf
    */
-  tl::optional<_Tp>
-  operator()(_Tp &tp, //
-             std::function<void(_Tp &)> interceptor = nullptr) {
-    return operator()(_makekey(tp), tl::make_optional<_Tp>(tp), interceptor);
+  void max_load_factor(double lf) { //
+    _max_load_factor = lf;
+  }
+
+  double max_load_factor() { //
+    return _max_load_factor;
   }
 
   /**
-   * @brief insert or update data (Rvalue)
+   * @brief shrink threshold (0: never shrink)
+   * the table never shrinks below its initial bucket size.
+   * set before the table is shared between threads.
    *
-   * @param tp
-   * @param interceptor
-   * @return tl::optional<_Tp>
+   * @param lf
+   */
+  void min_load_factor(double lf) { //
+    _min_load_factor = lf;
+  }
+
+  double min_load_factor() { //
+    return _min_load_factor;
+  }
+
+  /**
+   * @brief split or merge up to n buckets toward the load factor range.
+   * inserts and removes call this on their own; a helper thread may also
+   * call it to take the migration off the request path.
+   * does nothing if another thread is already migrating, or if called
+   * from inside a callback (bucket lock held).
+   *
+   * @param n
+   * @return size_t migrated buckets
+   */
+  size_t rehash_step(size_t n = 1) {
+    if (_lock_depth() > 0) {
+      return 0;
+    }
+    std::unique_lock<std::mutex> rl(_resize_lock, std::try_to_lock);
+    if (!rl.owns_lock()) {
+      return 0;
+    }
+    size_t done = 0;
+    while (done < n) {
+      size_t count = bucket_count();
+      size_t total = _size.load();
+      if (_max_load_factor > 0 && total > count * _max_load_factor) {
+        if (!_split()) {
+          break;
+        }
+      } else if (_min_load_factor > 0 && count > _bucket_size &&
+                 total < count * _min_load_factor) {
+        if (!_merge()) {
+          break;
+        }
+      } else {
+        break;
+      }
+      done++;
+    }
+    return done;
+  }
+
+  /**
+   * @brief element number of each bucket
+   *
+   * @return std::vector<size_t>
    */
-  tl::optional<_Tp>
-  operator()(_Tp &&tp, //
-             std::function<void(_Tp &)> interceptor = nullptr) {
-    return operator()(_makekey(tp), tl::make_optional<_Tp>(tp), interceptor);
+  std::vector<size_t> bucket_elements() {
+    std::vector<size_t> v(bucket_count(), 0);
+
+    for (size_t s = 0; s < _stripe_count; s++) {
+      LockedHashGuard guard(_get_bucket_lock(s), true);
+      size_t count = bucket_count();
+      if (v.size() < count) {
+        v.resize(count, 0);
+      }
+      for (size_t i = s; i < count; i = _next_bucket(i, s)) {
+        v[i] = _get_bucket(i).elements;
+      }
+    }
+    return v;
   }
 
   /**
-   * @brief insert or update or search
+   * @brief remove all data
+   * nodes are detached under each bucket lock and freed after it is
+   * released, in one batch per lock.
+   *
+   */
+  void clear() {
+    std::vector<LockedHashNode *> nodes;
+    for (size_t s = 0; s < _stripe_count; s++) {
+      {
+        LockedHashGuard guard(_get_bucket_lock(s));
+        size_t count = bucket_count();
+        for (size_t i = s; i < count; i = _next_bucket(i, s)) {
+          LockedHashBucket &bk = _get_bucket(i);
+          LockedHashNode *c = bk.head;
+          while (c) {
+            nodes.push_back(c);
+            _size.add(-1);
+            c = c->next;
+          }
+          _store(bk.head, nullptr);
+          bk.elements = 0;
+          bk.tags = 0;
+        }
+        // lock-free readers may still be walking these chains
+        if (_ReadMode::value == _ReadEpoch::value) {
+          for (LockedHashNode *c : nodes) {
+            _dispose(s, c);
+          }
+          nodes.clear();
+        }
+      }
+      _delete_nodes(nodes);
+    }
+    _rehash();
+  }
+
+private:
+  /**
+   * @brief insert or update or search (core of operator())
    *
    * @param key
+   * @param hash  _hash(key)
    * @param tp
    * @param interceptor
    * @return tl::optional<_Tp>
    */
-  tl::optional<_Tp>
-  operator()(_Key key,             //
-             tl::optional<_Tp> tp, //
-             std::function<void(_Tp &)> interceptor = nullptr) {
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _insert(const _K &key, size_t hash, //
+                            tl::optional<_Tp> &tp,      //
+                            _F &interceptor) {
+    if (!tp.has_value()) {
+      return _search(key, hash, interceptor, _ReadMode());
+    }
+    tl::optional<_Tp> ret = _insert_bucket(key, hash, tp, interceptor);
+    if (tp.has_value()) {
+      _rehash();
+    }
+    return ret;
+  }
+
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _search(const _K &key, size_t hash,
+                            _F &interceptor, _ReadLocked) {
+    tl::optional<_Tp> tp = tl::nullopt;
+    return _insert_bucket(key, hash, tp, interceptor);
+  }
+
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _search(const _K &key, size_t hash, _F &, _ReadSeq) {
+    typename std::aligned_storage<sizeof(_Tp), alignof(_Tp)>::type copy;
+    if (_read_optimistic(key, hash, copy)) {
+      return tl::make_optional<_Tp>(*reinterpret_cast<_Tp *>(&copy));
+    }
+    return tl::nullopt;
+  }
+
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _search(const _K &key, size_t hash, _F &, _ReadEpoch) {
+    tl::optional<_Tp> ret = tl::nullopt;
+    _read_epoch(key, hash, [&ret](const _Tp &tp) { ret = tp; });
+    return ret;
+  }
+
+  /**
+   * @brief call f on the value of key without taking the bucket lock
+   * (LockedHashEpochLock). the chain is walked with acquire loads inside
+   * an epoch, so no node seen can be freed meanwhile. a miss is retried if
+   * a split/merge was moving nodes; a hit is always valid.
+   *
+   * @return true  found (f was called)
+   */
+  template <typename _K, typename _F>
+  bool _read_epoch(const _K &key, size_t hash, _F &&f) {
+    LockedHashEpochGuard epoch;
+    size_t home, high;
+    _index(hash, home, high);
+
+    for (;;) {
+      size_t seq = _resize_seq.load(std::memory_order_acquire);
+      if (seq & 1) {
+        std::this_thread::yield();
+        continue;
+      }
+      size_t bucket = _get_bucket_index(home, high, _split_state.load());
+      LockedHashNode *c = _load(_get_bucket(bucket).head);
+      while (c) {
+        if (c->_hashcode == hash && _keyequal(_makekey(c->_tp), key)) {
+          f(c->_tp);
+          return true;
+        }
+        c = _load(c->next);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (_resize_seq.load(std::memory_order_relaxed) == seq) {
+        return false;
+      }
+    }
+  }
+
+  /**
+   * @brief call f on the value of c (bucket lock of home held)
+   * with LockedHashEpochLock, f gets a copy in a new node that replaces c,
+   * as lock-free readers may be reading c.
+   *
+   * @return LockedHashNode* node holding the value, nullptr if f removed it
+   */
+  template <typename _F>
+  LockedHashNode *_modify(size_t home, LockedHashBucket &bk, LockedHashNode *c,
+                          _F &f) {
+    return _modify(home, bk, c, f, _ReadMode());
+  }
+
+  template <typename _F, typename _Mode>
+  LockedHashNode *_modify(size_t, LockedHashBucket &, LockedHashNode *c,
+                          _F &f, _Mode) {
+    f(c->_tp);
+    return c;
+  }
+
+  template <typename _F>
+  LockedHashNode *_modify(size_t home, LockedHashBucket &bk, LockedHashNode *c,
+                          _F &f, _ReadEpoch) {
+    LockedHashNode *n = _new_node(c->_tp);
+    n->_hashcode = c->_hashcode;
+    n->_timestamp = c->_timestamp;
+    f(n->_tp);
+    // f may have removed or replaced c itself
+    if (!_linked(bk, c)) {
+      _delete_node(n);
+      return nullptr;
+    }
+    _replace(bk, c, n);
+    _dispose(home, c);
+    return n;
+  }
+
+  /**
+   * @brief copy out the value of key without taking the bucket lock
+   * (LockedHashSeqLock). the chain is walked with racy loads and every
+   * candidate is copied before its key is compared; the copy is used only
+   * if no writer took the lock in between. falls back to the lock after
+   * LOCKEDHASH_SEQLOCK_RETRIES tries.
+   *
+   * @return true  found (copy holds the value)
+   */
+  template <typename _K, typename _Storage_t>
+  bool _read_optimistic(const _K &key, size_t hash, _Storage_t &copy) {
+    size_t home, high;
+    _index(hash, home, high);
+    _Lock &lock = _get_home_lock(home);
+    const _Tp &tp = *reinterpret_cast<const _Tp *>(&copy);
+
+    for (int retry = 0; retry < LOCKEDHASH_SEQLOCK_RETRIES; retry++) {
+      size_t seq = lock.read_begin();
+      if (seq & 1) {
+        std::this_thread::yield();
+        continue;
+      }
+      size_t bucket = _get_bucket_index(home, high, _split_state.load());
+      LockedHashNode *c = LockedHashRacy::load(_get_bucket(bucket).head);
+      bool found = false;
+      while (c) {
+        if (LockedHashRacy::load(c->_hashcode) == hash) {
+          LockedHashRacy::copy(&copy, &c->_tp, sizeof(_Tp));
+          if (lock.read_retry(seq)) {
+            break;
+          }
+          if (_keyequal(_makekey(tp), key)) {
+            found = true;
+            break;
+          }
+        }
+        c = LockedHashRacy::load(c->next);
+        // a recycled node may lead anywhere (even in a circle)
+        if (lock.read_retry(seq)) {
+          break;
+        }
+      }
+      if (!lock.read_retry(seq)) {
+        return found;
+      }
+    }
+
+    LockedHashGuard guard(lock, true);
+    size_t bucket = _get_bucket_index(home, high, _split_state.load());
+    LockedHashNode *c = _chain(_get_bucket(bucket), hash);
+    while (c) {
+      if (c->_hashcode == hash && _keyequal(_makekey(c->_tp), key)) {
+        memcpy(&copy, &c->_tp, sizeof(_Tp));
+        return true;
+      }
+      c = c->next;
+    }
+    return false;
+  }
+
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _insert_bucket(const _K &key, size_t hash, //
+                                   tl::optional<_Tp> &tp,      //
+                                   _F &interceptor) {
     bool is_insert = tp.has_value();
-    size_t bucket = _get_bucket_index(key);
-    std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(bucket));
+    size_t home, high;
+    _index(hash, home, high);
+    // a search only reads
+    LockedHashGuard guard(_get_home_lock(home), !is_insert);
+    size_t bucket = _get_bucket_index(home, high, _split_state.load());
+    LockedHashBucket &bk = _get_bucket(bucket);
 
-    LockedHashNode *c = _buckets[bucket];
+    LockedHashNode *c = _chain(bk, hash);
     while (c) {
-      _Key k = _makekey(c->_tp);
-      if (k == key) {
+      if (c->_hashcode == hash && _keyequal(_makekey(c->_tp), key)) {
         if (!is_insert) {
           // only search
           return tl::make_optional<_Tp>(c->_tp);
         }
-        if (interceptor) {
+        if (LockedHashCallback::set(interceptor)) {
           // update data
-          interceptor(c->_tp);
-          c->_timestamp = time(nullptr);
+          c = _modify(home, bk, c, interceptor);
+          if (c) {
+            c->_timestamp = time(nullptr);
+          }
         }
         // insert 인 경우에만 return 값을 전달
         // update 인 경우에는 return nullopt 전달
-        // insert와 update 구분?
         return tl::nullopt;
-        // return tl::make_optional<_Tp>(c->_tp);
       }
       c = c->next;
     }
@@ -248,87 +1095,129 @@ public:
       return tl::nullopt;
     }
 
-    c = new LockedHashNode(*tp);
-    c->next = _buckets[bucket];
-    _buckets[bucket] = c;
-    if (c->next) {
-      c->next->prev = c;
-    }
+    c = _new_node(std::move(*tp));
+    c->_hashcode = hash;
+    _link(bk, c);
 
-    _bucket_elements[bucket]++;
-    _size++;
+    bk.elements++;
+    _size.add(1);
 
     return tl::make_optional<_Tp>(c->_tp);
   }
 
-  /**
-   * @brief element number of each bucket
-   *
-   * @return std::vector<size_t>
-   */
-  std::vector<size_t> bucket_elements() {
-    std::vector<size_t> v;
+  /// construct a value for key in place, unless key is there already
+  template <typename _K, typename... _Args>
+  bool _emplace(const _K &key, size_t hash, _Args &&...args) {
+    {
+      size_t home, high;
+      _index(hash, home, high);
+      LockedHashGuard guard(_get_home_lock(home));
+      if (_node(key, hash, home, high)) {
+        return false;
+      }
+      size_t bucket = _get_bucket_index(home, high, _split_state.load());
+      LockedHashBucket &bk = _get_bucket(bucket);
+      LockedHashNode *c = _new_node(std::forward<_Args>(args)...);
+      c->_hashcode = hash;
+      _link(bk, c);
 
-    for (size_t i = 0; i < _bucket_size; i++) {
-      std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(i));
-      v.push_back(_bucket_elements[i].load());
+      bk.elements++;
+      _size.add(1);
     }
-    return v;
+    _rehash();
+    return true;
   }
 
   /**
-   * @brief rm(tp) - remove Lvalue
-   *
-   * @param tp
-   * @return tl::optional<_Tp>
+   * @brief one locked pass of compute(): fn creates, changes or removes
+   * the value of key. with LockedHashEpochLock fn changes a copy that
+   * replaces the node (_modify).
    */
-  tl::optional<_Tp> rm(_Tp &tp) { //
-    return rm(_makekey(tp));
-  }
+  template <typename _K, typename _F>
+  LockedHashOutcome _compute(const _K &key, size_t hash, _F &fn) {
+    LockedHashOutcome outcome = LockedHashOutcome::updated;
+    {
+      size_t home, high;
+      _index(hash, home, high);
+      LockedHashGuard guard(_get_home_lock(home));
+      size_t bucket = _get_bucket_index(home, high, _split_state.load());
+      LockedHashBucket &bk = _get_bucket(bucket);
+      LockedHashNode *c = _node(key, hash, home, high);
 
-  /**
-   * @brief remove data for Rvalue
-   *
-   * @param tp
-   * @return tl::optional<_Tp>
-   */
-  tl::optional<_Tp> rm(_Tp &&tp) { //
-    return rm(_makekey(tp));
+      if (c == nullptr) {
+        tl::optional<_Tp> tp = LockedHashEntry<_Tp>::create(fn);
+        if (!tp.has_value()) {
+          return LockedHashOutcome::absent;
+        }
+        c = _new_node(std::move(*tp));
+        c->_hashcode = hash;
+        _link(bk, c);
+        bk.elements++;
+        _size.add(1);
+        outcome = LockedHashOutcome::inserted;
+      } else {
+        bool erase = false;
+        auto f = [&fn, &erase](_Tp &tp) {
+          erase = LockedHashEntry<_Tp>::update(fn, tp);
+        };
+        c = _modify(home, bk, c, f);
+        if (c == nullptr) {
+          // fn removed it by itself
+          outcome = LockedHashOutcome::removed;
+        } else if (erase) {
+          _unlink(bk, c);
+          _size.add(-1);
+          bk.elements--;
+          _dispose(home, c);
+          outcome = LockedHashOutcome::removed;
+        } else {
+          c->_timestamp = time(nullptr);
+          return outcome;
+        }
+      }
+    }
+    _rehash();
+    return outcome;
   }
 
   /**
-   * @brief remove data for
+   * @brief remove data for key (core of rm())
    *
    * @param key
+   * @param hash  _hash(key)
+   * @param rmf
    * @return tl::optional<_Tp>
    */
-  tl::optional<_Tp> rm(_Key key, std::function<bool(_Tp &tp)> rmf = nullptr) {
-    size_t bucket = _get_bucket_index(key);
-    std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(bucket));
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _rm(const _K &key, size_t hash, _F &rmf) {
+    tl::optional<_Tp> opt = _rm_bucket(key, hash, rmf);
+    if (opt.has_value()) {
+      _rehash();
+    }
+    return opt;
+  }
+
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _rm_bucket(const _K &key, size_t hash, _F &rmf) {
+    size_t home, high;
+    _index(hash, home, high);
+    LockedHashGuard guard(_get_home_lock(home));
+    size_t bucket = _get_bucket_index(home, high, _split_state.load());
+    LockedHashBucket &bk = _get_bucket(bucket);
     tl::optional<_Tp> opt = tl::nullopt;
 
-    LockedHashNode *c = _buckets[bucket];
+    LockedHashNode *c = _chain(bk, hash);
     while (c) {
-      _Key k = _makekey(c->_tp);
-      if (k == key) {
-        if (c == _buckets[bucket]) {
-          _buckets[bucket] = c->next;
-        } else {
-          c->prev->next = c->next;
-        }
-        if (c->next) {
-          c->next->prev = c->prev;
-        }
-        bool do_delete = true;
-        if (rmf) {
-          do_delete = rmf(c->_tp);
-        }
-        if (do_delete) {
-          _size--;
-          _bucket_elements[bucket]--;
-          opt = tl::make_optional<_Tp>(c->_tp);
-          delete c;
+      if (c->_hashcode == hash && _keyequal(_makekey(c->_tp), key)) {
+        if (LockedHashCallback::set(rmf) && !rmf(c->_tp)) {
+          // keep the node
+          return opt;
         }
+        _unlink(bk, c);
+        _size.add(-1);
+        bk.elements--;
+        opt = _move_out(c);
+        _dispose(home, c);
         return opt;
       }
       c = c->next;
@@ -336,15 +1225,18 @@ public:
     return opt;
   }
 
-  void find(_Key key, std::function<void(_Tp &tp)> findf) {
-    size_t bucket = _get_bucket_index(key);
-    std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(bucket));
+  template <typename _K, typename _F>
+  void _find(const _K &key, size_t hash, _F &findf) {
+    size_t home, high;
+    _index(hash, home, high);
+    LockedHashGuard guard(_get_home_lock(home));
+    size_t bucket = _get_bucket_index(home, high, _split_state.load());
+    LockedHashBucket &bk = _get_bucket(bucket);
 
-    LockedHashNode *c = _buckets[bucket];
+    LockedHashNode *c = _chain(bk, hash);
     while (c) {
-      _Key k = _makekey(c->_tp);
-      if (k == key) {
-        findf(c->_tp);
+      if (c->_hashcode == hash && _keyequal(_makekey(c->_tp), key)) {
+        _modify(home, bk, c, findf);
         return;
       }
       c = c->next;
@@ -352,104 +1244,168 @@ public:
     return;
   }
 
-  void find(_Tp &&tp, std::function<void(_Tp &tp)> findf) { //
-    return find(_makekey(tp), findf);
+  template <typename _K, typename _F>
+  void _find_shared(const _K &key, size_t hash, _F &findf) {
+    _find_shared(key, hash, findf, _ReadMode());
   }
 
-  void find(_Tp &tp, std::function<void(_Tp &tp)> findf) { //
-    return find(_makekey(tp), findf);
+  /// copy out, then call findf without any lock
+  template <typename _K, typename _F>
+  void _find_shared(const _K &key, size_t hash, _F &findf, _ReadSeq) {
+    typename std::aligned_storage<sizeof(_Tp), alignof(_Tp)>::type copy;
+    if (_read_optimistic(key, hash, copy)) {
+      findf(*reinterpret_cast<const _Tp *>(&copy));
+    }
   }
 
-  /**
-   * @brief loop(lambda loop function)
-   * loopf 결과가 true인 경우 Node의 timestamp를 업데이트 한다.
-   *
-   * @param loopf
-   */
-  void
-  loop(std::function<bool(size_t bucket, time_t timestamp, _Tp &tp)> loopf) {
-    for (size_t i = 0; i < _bucket_size; i++) {
-      std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(i));
-      LockedHashNode *c = _buckets[i];
-      while (c) {
-        if (loopf(i, c->_timestamp, c->_tp)) {
-          c->_timestamp = time(nullptr);
-        }
-        c = c->next;
+  template <typename _K, typename _F>
+  void _find_shared(const _K &key, size_t hash, _F &findf, _ReadEpoch) {
+    _read_epoch(key, hash, findf);
+  }
+
+  template <typename _K, typename _F>
+  void _find_shared(const _K &key, size_t hash, _F &findf, _ReadLocked) {
+    size_t home, high;
+    _index(hash, home, high);
+    LockedHashGuard guard(_get_home_lock(home), true);
+    size_t bucket = _get_bucket_index(home, high, _split_state.load());
+
+    LockedHashNode *c = _chain(_get_bucket(bucket), hash);
+    while (c) {
+      if (c->_hashcode == hash && _keyequal(_makekey(c->_tp), key)) {
+        findf(c->_tp);
+        return;
+      }
+      c = c->next;
+    }
+  }
+
+  /// node of key in its bucket (bucket lock held), nullptr if none
+  template <typename _K>
+  LockedHashNode *_node(const _K &key, size_t hash, size_t home,
+                        size_t high) {
+    size_t bucket = _get_bucket_index(home, high, _split_state.load());
+    LockedHashNode *c = _chain(_get_bucket(bucket), hash);
+    while (c) {
+      if (c->_hashcode == hash && _keyequal(_makekey(c->_tp), key)) {
+        return c;
       }
+      c = c->next;
     }
+    return nullptr;
+  }
+
+  template <typename _K> accessor _access(const _K &key, size_t hash) {
+    static_assert(_ReadMode::value != _ReadEpoch::value,
+                  "LockedHashEpochLock replaces values instead of changing "
+                  "them in place: use find or access_shared");
+    size_t home, high;
+    _index(hash, home, high);
+    LockedHashGuard guard(_get_home_lock(home));
+    LockedHashNode *c = _node(key, hash, home, high);
+    return accessor(std::move(guard), c ? &c->_tp : nullptr);
+  }
+
+  template <typename _K>
+  const_accessor _access_shared(const _K &key, size_t hash) {
+    size_t home, high;
+    _index(hash, home, high);
+    LockedHashGuard guard(_get_home_lock(home), true);
+    LockedHashNode *c = _node(key, hash, home, high);
+    return const_accessor(std::move(guard), c ? &c->_tp : nullptr);
+  }
+
+  template <typename _K>
+  tl::optional<_Tp> _alive(const _K &key, size_t hash) {
+    size_t home, high;
+    _index(hash, home, high);
+    LockedHashGuard guard(_get_home_lock(home));
+    size_t bucket = _get_bucket_index(home, high, _split_state.load());
+
+    LockedHashNode *c = _chain(_get_bucket(bucket), hash);
+    while (c) {
+      if (c->_hashcode == hash && _keyequal(_makekey(c->_tp), key)) {
+        c->_timestamp = time(nullptr);
+        return tl::make_optional<_Tp>(c->_tp);
+      }
+      c = c->next;
+    }
+    return tl::nullopt;
   }
 
   /**
-   * @brief loop_with_delete(lambda loop function)
-   * loopf 결과가 true인 경우 Node를 제거한다.
+   * @brief core of loop()
+   * loopf 결과가 true인 경우 Node의 timestamp를 업데이트 한다.
    *
    * @param loopf
    */
-  void loop_with_delete(
-      std::function<bool(size_t bucket, time_t timestamp, _Tp &tp)> loopf) {
-    for (size_t i = 0; i < _bucket_size; i++) {
-      std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(i));
-      LockedHashNode *c = _buckets[i];
-      LockedHashNode *tmp;
-      while (c) {
-        if (loopf(i, c->_timestamp, c->_tp)) {
-          tmp = c->next;
-          if (c == _buckets[i]) {
-            _buckets[i] = c->next;
-          } else {
-            c->prev->next = c->next;
+  template <typename _F> void _loop(_F &loopf) {
+    for (size_t s = 0; s < _stripe_count; s++) {
+      LockedHashGuard guard(_get_bucket_lock(s));
+      size_t count = bucket_count();
+      for (size_t i = s; i < count; i = _next_bucket(i, s)) {
+        LockedHashNode *c = _get_bucket(i).head;
+        while (c) {
+          if (loopf(i, c->_timestamp, c->_tp)) {
+            c->_timestamp = time(nullptr);
           }
-          if (c->next) {
-            c->next->prev = c->prev;
-          }
-          _size--;
-          _bucket_elements[i]--;
-          delete c;
-
-          c = tmp;
-        } else {
           c = c->next;
         }
       }
     }
   }
 
-  void clear() {
-    for (size_t i = 0; i < _bucket_size; i++) {
-      std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(i));
-      LockedHashNode *c = _buckets[i];
-      LockedHashNode *tmp;
-      while (c) {
-        tmp = c->next;
-        if (c == _buckets[i]) {
-          _buckets[i] = c->next;
-        } else {
-          c->prev->next = c->next;
-        }
-        if (c->next) {
-          c->next->prev = c->prev;
+  /**
+   * @brief core of loop_shared()
+   * loop under a shared lock (LockedHashSharedLock); loopf only reads and
+   * must not modify the table.
+   *
+   * @param loopf
+   */
+  template <typename _F> void _loop_shared(_F &loopf) {
+    for (size_t s = 0; s < _stripe_count; s++) {
+      LockedHashGuard guard(_get_bucket_lock(s), true);
+      size_t count = bucket_count();
+      for (size_t i = s; i < count; i = _next_bucket(i, s)) {
+        LockedHashNode *c = _get_bucket(i).head;
+        while (c) {
+          loopf(i, c->_timestamp, c->_tp);
+          c = c->next;
         }
-        _size--;
-        _bucket_elements[i]--;
-        delete c;
-
-        c = tmp;
       }
     }
   }
 
   /**
-   * @brief expire_time 이상 업데이트 되지 않은 Node를 삭제한다.
-   * expire_time이 0일 경우, 동작하지 않음.
+   * @brief core of loop_with_delete()
+   * loopf 결과가 true인 경우 Node를 제거한다.
    *
-   * @return tl::optional<std::list<_Tp>> 삭제된 내용이 있으면 list, 없으면
-   * tl::nullopt를 반환.
+   * @param loopf
    */
-  tl::optional<std::list<_Tp>> expire(                                        //
-      std::function<bool(_Tp &, time_t timestamp, void *)> expiref = nullptr, //
-      void *arg = nullptr) {                                                  //
-    return expiref ? _expire(expiref, arg) : _expire();
+  template <typename _F> void _loop_with_delete(_F &loopf) {
+    for (size_t s = 0; s < _stripe_count; s++) {
+      LockedHashGuard guard(_get_bucket_lock(s));
+      size_t count = bucket_count();
+      for (size_t i = s; i < count; i = _next_bucket(i, s)) {
+        LockedHashBucket &bk = _get_bucket(i);
+        LockedHashNode *c = bk.head;
+        LockedHashNode *tmp;
+        while (c) {
+          if (loopf(i, c->_timestamp, c->_tp)) {
+            tmp = c->next;
+            _unlink(bk, c);
+            _size.add(-1);
+            bk.elements--;
+            _dispose(s, c);
+
+            c = tmp;
+          } else {
+            c = c->next;
+          }
+        }
+      }
+    }
+    _rehash();
   }
 
   tl::optional<std::list<_Tp>> _expire() {
@@ -459,122 +1415,106 @@ public:
     std::list<_Tp> expired;
 
     time_t now = time(nullptr);
-    for (size_t i = 0; i < _bucket_size; i++) {
-      std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(i));
-      LockedHashNode *c = _buckets[i];
-      LockedHashNode *tmp;
+    for (size_t s = 0; s < _stripe_count; s++) {
+      LockedHashGuard guard(_get_bucket_lock(s));
+      size_t count = bucket_count();
+      for (size_t i = s; i < count; i = _next_bucket(i, s)) {
+        LockedHashBucket &bk = _get_bucket(i);
+        LockedHashNode *c = bk.head;
+        LockedHashNode *tmp;
 
-      while (c) {
-        if (now - c->_timestamp > _expire_time) {
-          tmp = c->next;
-          if (c == _buckets[i]) {
-            _buckets[i] = c->next;
-          } else {
-            c->prev->next = c->next;
-          }
-          if (c->next) {
-            c->next->prev = c->prev;
-          }
-          _size--;
-          _bucket_elements[i]--;
+        while (c) {
+          if (now - c->_timestamp > _expire_time) {
+            tmp = c->next;
+            _unlink(bk, c);
+            _size.add(-1);
+            bk.elements--;
 
-          expired.push_back(c->_tp);
-          delete c;
+            expired.push_back(_move_out(c));
+            _dispose(s, c);
 
-          c = tmp;
-        } else {
-          c = c->next;
+            c = tmp;
+          } else {
+            c = c->next;
+          }
         }
       }
     }
+    _rehash();
 
-    return expired.empty() ? tl::nullopt : tl::make_optional(expired);
+    return expired.empty() ? tl::nullopt
+                           : tl::make_optional(std::move(expired));
   }
 
-  tl::optional<std::list<_Tp>>
-  _expire(std::function<bool(_Tp &, time_t timestamp, void *)> expiref,
-          void *arg) {
+  template <typename _F>
+  tl::optional<std::list<_Tp>> _expire(_F &expiref, void *arg) {
     std::list<_Tp> expired;
 
-    for (size_t i = 0; i < _bucket_size; i++) {
-      std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(i));
-      LockedHashNode *c = _buckets[i];
-      LockedHashNode *tmp;
+    for (size_t s = 0; s < _stripe_count; s++) {
+      LockedHashGuard guard(_get_bucket_lock(s));
+      size_t count = bucket_count();
+      for (size_t i = s; i < count; i = _next_bucket(i, s)) {
+        LockedHashBucket &bk = _get_bucket(i);
+        LockedHashNode *c = bk.head;
+        LockedHashNode *tmp;
 
-      while (c) {
-        if (expiref(c->_tp, c->_timestamp, arg)) {
-          tmp = c->next;
-          if (c == _buckets[i]) {
-            _buckets[i] = c->next;
-          } else {
-            c->prev->next = c->next;
-          }
-          if (c->next) {
-            c->next->prev = c->prev;
-          }
-          _size--;
-          _bucket_elements[i]--;
+        while (c) {
+          if (expiref(c->_tp, c->_timestamp, arg)) {
+            tmp = c->next;
+            _unlink(bk, c);
+            _size.add(-1);
+            bk.elements--;
 
-          expired.push_back(c->_tp);
-          delete c;
+            expired.push_back(_move_out(c));
+            _dispose(s, c);
 
-          c = tmp;
-        } else {
-          c = c->next;
+            c = tmp;
+          } else {
+            c = c->next;
+          }
         }
       }
     }
+    _rehash();
 
-    return expired.empty() ? tl::nullopt : tl::make_optional(expired);
-  }
-
-  void showdata(std::function<void(size_t bucket, _Tp &tp)> showdataf) {
-    for (size_t i = 0; i < _bucket_size; i++) {
-      if (_bucket_elements[i].load() == 0) {
-        continue;
-      }
-      std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(i));
-      LockedHashNode *c = _buckets[i];
-      while (c) {
-        showdataf(i, c->_tp);
-        c = c->next;
-      }
-    }
-  }
-
-  void showbucket(std::function<void(size_t bucket, size_t cnt)> showdataf) {
-    for (size_t i = 0; i < _bucket_size; i++) {
-      showdataf(i, _bucket_elements[i].load());
-    }
+    return expired.empty() ? tl::nullopt
+                           : tl::make_optional(std::move(expired));
   }
 
   /**
-   * @brief (life)timestamp update
+   * @brief core of showdata()
+   * runs under a shared lock; showdataf must not modify tp.
    *
-   * @param key
-   * @return true
-   * @return false
+   * @param showdataf
    */
-  tl::optional<_Tp> //
-  alive(_Key &key) {
-    size_t bucket = _get_bucket_index(key);
-    std::lock_guard<std::recursive_mutex> guard(_get_bucket_lock(bucket));
-
-    LockedHashNode *c = _buckets[bucket];
-    while (c) {
-      _Key k = _makekey(c->_tp);
-      if (k == key) {
-        c->_timestamp = time(nullptr);
-        return tl::make_optional<_Tp>(c->_tp);
+  template <typename _F> void _showdata(_F &showdataf) {
+    for (size_t s = 0; s < _stripe_count; s++) {
+      LockedHashGuard guard(_get_bucket_lock(s), true);
+      size_t count = bucket_count();
+      for (size_t i = s; i < count; i = _next_bucket(i, s)) {
+        LockedHashBucket &bk = _get_bucket(i);
+        if (bk.elements == 0) {
+          continue;
+        }
+        LockedHashNode *c = bk.head;
+        while (c) {
+          showdataf(i, c->_tp);
+          c = c->next;
+        }
       }
-      c = c->next;
     }
-    return tl::nullopt;
   }
 
-  tl::optional<_Tp> //
-  alive(_Key &&key) {
-    return alive(key);
+  template <typename _F> void _showbucket(_F &showdataf) {
+    size_t count = bucket_count();
+    for (size_t i = 0; i < count; i++) {
+      size_t cnt;
+      {
+        LockedHashGuard guard(_get_bucket_lock(i), true);
+        cnt = _get_bucket(i).elements;
+      }
+      showdataf(i, cnt);
+    }
   }
 };
 
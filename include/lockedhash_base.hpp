@@ -0,0 +1,1396 @@
+#ifndef __LOCKED_HASH_BASE_HPP__
+#define __LOCKED_HASH_BASE_HPP__
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <lockedhash_hash.hpp>
+#include <lockedhash_index.hpp>
+#include <lockedhash_lock.hpp>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional.hpp>
+#include <time.h>
+#include <type_traits>
+
+/// keys a multi_*() call hashes and groups by lock stripe at a time
+#define LOCKEDHASH_BATCH_KEYS 256
+/// keys a batch prefetches ahead of the one it works on (0: none)
+#ifndef LOCKEDHASH_PREFETCH_DISTANCE
+#define LOCKEDHASH_PREFETCH_DISTANCE 8
+#endif
+
+/**
+ * @brief storage policy: doubly linked chain per bucket
+ *
+ * @tparam _Index bucket index policy (LockedHashIndexModulo,
+ *                LockedHashIndexMask, LockedHashIndexFastrange,
+ *                LockedHashIndexReciprocal)
+ * @tparam _Lock  bucket lock policy (LockedHashRecursiveLock,
+ *                LockedHashSharedLock, LockedHashSeqLock,
+ *                LockedHashEpochLock)
+ */
+template <typename _Index = LockedHashIndexModulo,
+          typename _Lock = LockedHashRecursiveLock>
+struct LockedHashChainedPolicy {
+  typedef _Index index_type;
+  typedef _Lock lock_type;
+};
+
+/**
+ * @brief storage policy: doubly linked chain per bucket (default)
+ *
+ */
+typedef LockedHashChainedPolicy<> LockedHashChained;
+
+/**
+ * @brief storage policy: open addressing over 16-slot groups with
+ * SwissTable-style 1-byte control metadata
+ *
+ */
+struct LockedHashSwiss {};
+
+/**
+ * @brief storage policy: lock-free split-ordered list (no bucket locks)
+ *
+ */
+struct LockedHashSplitOrdered {};
+
+/**
+ * @brief storage policy: bucketized cuckoo hashing (4 slots per bucket,
+ * two buckets per key)
+ *
+ */
+struct LockedHashCuckoo {};
+
+/**
+ * @brief LockedHash
+ *
+ * @tparam _Key      Type of key objects.
+ * @tparam _Tp       Type of mapped objects.
+ * @tparam _Hash     Hashing function object type
+ * @tparam _MakeKey  Make Key function object type (may return const _Key &)
+ * @tparam _Storage  Storage policy (LockedHashChained,
+ *                   LockedHashChainedPolicy<_Index>, LockedHashSwiss,
+ *                   LockedHashSplitOrdered, LockedHashCuckoo)
+ * @tparam _KeyEqual Key equality function object type
+ * @tparam _KeyHash  Key hashing function object type. The table only ever
+ *                   hashes keys; set this when _Hash takes a _Tp, so that
+ *                   a key is not converted to a _Tp on every hash.
+ * @tparam _Alloc    Allocator type, rebound to the storage node
+ *                   (LockedHashSlabAllocator<_Tp> for a slab pool)
+ */
+template <typename _Key, typename _Tp, typename _Hash, typename _MakeKey,
+          typename _Storage = LockedHashChained,
+          typename _KeyEqual = std::equal_to<_Key>, typename _KeyHash = _Hash,
+          typename _Alloc = std::allocator<_Tp>>
+class LockedHash;
+
+/**
+ * @brief LockedHashAccessor
+ * a value in place, with the lock that guards it held until the accessor
+ * is destroyed or released. empty if the key was not found.
+ *
+ *   if (auto a = hash.access(key)) {
+ *     a->count++;
+ *   }
+ *
+ * the accessor must not outlive the table and must be destroyed on the
+ * thread that made it. while it is held, other writers of its bucket wait.
+ *
+ * @tparam _Tp    _Tp, or const _Tp
+ * @tparam _Guard movable lock guard of the storage engine
+ */
+template <typename _Tp, typename _Guard> class LockedHashAccessor {
+private:
+  _Guard _guard;
+  _Tp *_tp;
+
+public:
+  LockedHashAccessor(_Guard &&guard, _Tp *tp)
+      : _guard(std::move(guard)), _tp(tp) {
+    if (_tp == nullptr) {
+      _guard.release();
+    }
+  }
+
+  LockedHashAccessor(LockedHashAccessor &&o)
+      : _guard(std::move(o._guard)), _tp(o._tp) {
+    o._tp = nullptr;
+  }
+
+  LockedHashAccessor(const LockedHashAccessor &) = delete;
+  LockedHashAccessor &operator=(const LockedHashAccessor &) = delete;
+
+  explicit operator bool() const { //
+    return _tp != nullptr;
+  }
+
+  _Tp &operator*() const { //
+    return *_tp;
+  }
+
+  _Tp *operator->() const { //
+    return _tp;
+  }
+
+  /// unlock early; the accessor is empty afterwards
+  void release() {
+    _tp = nullptr;
+    _guard.release();
+  }
+};
+
+/**
+ * @brief what compute() and merge() did
+ */
+enum class LockedHashOutcome {
+  /// key was absent and stays absent
+  absent,
+  /// a value was created for key
+  inserted,
+  /// the value of key was changed (or only looked at)
+  updated,
+  /// the value of key was removed
+  removed,
+  /// fn created a value but it was dropped: the shard is full and can not
+  /// grow while a callback up the stack walks it (LockedHashSwiss,
+  /// LockedHashCuckoo)
+  full,
+};
+
+/**
+ * @brief a key with its hash, computed once
+ * every keyed call of LockedHash takes one in place of the key and skips
+ * hashing it.
+ *
+ *   auto hk = hash.hashed(key);
+ *   hash.find(hk, ...);
+ *   hash(hk, [](Flow &f) { f.packets++; });
+ *   hash.rm(hk);
+ *
+ * a hash from elsewhere (a packet parser, ...) can be given with
+ * LockedHashHashedKey<_Key>{key, hash}; it must equal _KeyHash()(key).
+ *
+ * @tparam _Key
+ */
+template <typename _Key> struct LockedHashHashedKey {
+  _Key key;
+  size_t hash;
+};
+
+/**
+ * @brief LockedHashEntry
+ * entry of a key inside compute(). the callback reads the value, changes
+ * it in place, creates or replaces it (emplace), or removes it (erase),
+ * all under the one lock of the call.
+ *
+ *   hash.compute(key, [&](LockedHashEntry<Counter> &e) {
+ *     if (e) {
+ *       e->n++;
+ *     } else {
+ *       e.emplace(key, 1);
+ *     }
+ *   });
+ *
+ * @tparam _Tp
+ */
+template <typename _Tp> class LockedHashEntry {
+private:
+  _Tp *_tp;
+  /// value emplaced by the callback
+  tl::optional<_Tp> &_made;
+  bool _erased = false;
+
+  LockedHashEntry(_Tp *tp, tl::optional<_Tp> &made) : _tp(tp), _made(made) {}
+
+public:
+  LockedHashEntry(const LockedHashEntry &) = delete;
+  LockedHashEntry &operator=(const LockedHashEntry &) = delete;
+
+  /// the key has a value (found, or emplaced by the callback)
+  explicit operator bool() const { //
+    return _tp != nullptr;
+  }
+
+  _Tp &operator*() const { //
+    return *_tp;
+  }
+
+  _Tp *operator->() const { //
+    return _tp;
+  }
+
+  /// create the value, or replace the current one
+  template <typename... _Args> _Tp &emplace(_Args &&...args) {
+    _made.emplace(std::forward<_Args>(args)...);
+    _tp = &*_made;
+    _erased = false;
+    return *_tp;
+  }
+
+  /// remove the value
+  void erase() {
+    _made.reset();
+    _tp = nullptr;
+    _erased = true;
+  }
+
+  /**
+   * @brief run fn on the entry of a missing key (storage engines)
+   *
+   * @return tl::optional<_Tp> the value fn created, if any
+   */
+  template <typename _F> static tl::optional<_Tp> create(_F &fn) {
+    tl::optional<_Tp> made;
+    LockedHashEntry e(nullptr, made);
+    fn(e);
+    return made;
+  }
+
+  /**
+   * @brief run fn on the entry of tp (storage engines)
+   * tp is replaced by the value fn emplaced, if any.
+   *
+   * @return true  fn erased the entry
+   */
+  template <typename _F> static bool update(_F &fn, _Tp &tp) {
+    tl::optional<_Tp> made;
+    LockedHashEntry e(&tp, made);
+    fn(e);
+    if (e._erased) {
+      return true;
+    }
+    if (made.has_value()) {
+      tp = std::move(*made);
+    }
+    return false;
+  }
+};
+
+template <typename... _Ts> struct LockedHashVoid { typedef void type; };
+
+/**
+ * @brief true if _F can be called with (_Args...)
+ */
+template <typename _F, typename _Sig, typename = void>
+struct LockedHashIsCallable : std::false_type {};
+
+template <typename _F, typename... _Args>
+struct LockedHashIsCallable<
+    _F, void(_Args...),
+    typename LockedHashVoid<decltype(std::declval<_F &>()(
+        std::declval<_Args>()...))>::type> : std::true_type {};
+
+/**
+ * @brief callbacks of the storage engines
+ * the engines take any callable type, so that a lambda is inlined into the
+ * walk; a std::function may be empty (callback left out).
+ */
+struct LockedHashCallback {
+  template <typename _F> static bool set(const _F &) { //
+    return true;
+  }
+
+  template <typename _R, typename... _Args>
+  static bool set(const std::function<_R(_Args...)> &f) {
+    return static_cast<bool>(f);
+  }
+
+  template <typename _R, typename... _Args> static bool set(_R (*f)(_Args...)) {
+    return f != nullptr;
+  }
+};
+
+/**
+ * @brief true if _T declares is_transparent
+ */
+template <typename _T, typename = void>
+struct LockedHashIsTransparent : std::false_type {};
+
+template <typename _T>
+struct LockedHashIsTransparent<
+    _T, typename LockedHashVoid<typename _T::is_transparent>::type>
+    : std::true_type {};
+
+/**
+ * @brief true if _H hashes an array of _K at once:
+ * batch(const _K *keys, size_t n, size_t *out)
+ */
+template <typename _H, typename _K, typename = void>
+struct LockedHashIsBatchHash : std::false_type {};
+
+template <typename _H, typename _K>
+struct LockedHashIsBatchHash<
+    _H, _K,
+    typename LockedHashVoid<decltype(std::declval<_H &>().batch(
+        std::declval<const _K *>(), size_t(), std::declval<size_t *>()))>::type>
+    : std::true_type {};
+
+/**
+ * @brief LockedHashBase
+ * public API shared by every storage policy. hashing happens here; a
+ * storage engine (_Derived) implements the core for a key of any type
+ * _K (_Key, or a heterogeneous key) and its hash:
+ *  - _insert(key, hash, tl::optional<_Tp> &tp, interceptor)
+ *  - _rm(key, hash, rmf)
+ *  - _find(key, hash, findf)
+ *  - _find_shared(key, hash, findf)
+ *  - _alive(key, hash)
+ *  - _access(key, hash), _access_shared(key, hash)
+ *  - _emplace(key, hash, args...), _compute(key, hash, fn)
+ *  - _expire(), _expire(expiref, arg)
+ *  - _loop(loopf), _loop_shared(loopf), _loop_with_delete(loopf)
+ *  - _showdata(showdataf), _showbucket(showdataf)
+ * and, for the multi_*() batches (lock-free engines keep the defaults):
+ *  - _stripe(hash): lock stripe of hash
+ *  - _lock_stripe(hash, shared): guard holding the stripe of hash
+ *  - _batch_end(): after a stripe of a writing batch is released
+ *  - _prefetch(hash, stage): stage 0 fetches the bucket of hash, stage 1
+ *    what the bucket points to
+ * callbacks are passed as any callable type _F (see LockedHashCallback).
+ *
+ * @tparam _Derived  storage engine
+ */
+template <typename _Derived, typename _Key, typename _Tp, typename _MakeKey,
+          typename _KeyEqual, typename _KeyHash>
+class LockedHashBase {
+protected:
+  /// key hash function
+  _KeyHash _hash;
+  /// make key function
+  _MakeKey _makekey;
+  /// key equality function
+  _KeyEqual _keyequal;
+
+  _Derived &_self() { //
+    return static_cast<_Derived &>(*this);
+  }
+
+public:
+  typedef LockedHashHashedKey<_Key> hashed_key;
+
+protected:
+  /// heterogeneous key _K: both _KeyHash and _KeyEqual are transparent
+  template <typename _K>
+  using _if_transparent = typename std::enable_if<
+      LockedHashIsTransparent<_KeyHash>::value &&
+          LockedHashIsTransparent<_KeyEqual>::value &&
+          !std::is_same<typename std::decay<_K>::type, _Key>::value &&
+          !std::is_same<typename std::decay<_K>::type, _Tp>::value &&
+          !std::is_same<typename std::decay<_K>::type, hashed_key>::value,
+      int>::type;
+
+  /// _F is a callable of (_Args...): the templated callback overloads. the
+  /// std::function ones stay for callers that need a fixed signature.
+  template <typename _F, typename... _Args>
+  using _if_callable = typename std::enable_if<
+      LockedHashIsCallable<_F, void(_Args...)>::value, int>::type;
+
+  /// _compute may run fn more than once (engines that retry set this)
+  static const bool _compute_retries = false;
+
+  /// no locks: a batch is one group
+  static size_t _stripe(size_t) { //
+    return 0;
+  }
+
+  static std::unique_lock<std::mutex> _lock_stripe(size_t, bool) {
+    return std::unique_lock<std::mutex>();
+  }
+
+  static void _batch_end() {}
+
+  static void _prefetch(size_t, int) {}
+
+  /// what f(tp) returns, by value
+  template <typename _F, typename _T>
+  using _result_t = typename std::decay<
+      typename std::result_of<_F &(_T &)>::type>::type;
+
+public:
+  /**
+   * @brief key with its hash, for several calls on the same key
+   *
+   * @param key
+   * @return hashed_key
+   */
+  hashed_key hashed(_Key key) { //
+    return hashed_key{key, _hash(key)};
+  }
+
+  /**
+   * @brief search data (lvalue)
+   *
+   * @param key
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp> operator()(_Key key) {
+    return operator()(key, tl::nullopt);
+  }
+
+  /**
+   * @brief search data (prehashed key)
+   *
+   * @param hk
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp> operator()(const hashed_key &hk) {
+    return operator()(hk, tl::nullopt);
+  }
+
+  /**
+   * @brief search data (heterogeneous key)
+   * ex) find("name") without building a std::string
+   *
+   * @param key
+   * @return tl::optional<_Tp>
+   */
+  template <typename _K, _if_transparent<_K> = 0>
+  tl::optional<_Tp> operator()(const _K &key) {
+    tl::optional<_Tp> tp = tl::nullopt;
+    std::function<void(_Tp &)> interceptor = nullptr;
+    return _self()._insert(key, _hash(key), tp, interceptor);
+  }
+
+  /**
+   * @brief search data (lvalue)
+   *
+   * @param key
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp> operator[](_Key &key) { //
+    return operator[](std::move(key));
+  }
+
+  /**
+   * @brief search data (rvalue)
+   *
+   * @param key
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp> operator[](_Key &&key) { //
+    return operator()(key);
+  }
+
+  /**
+   * @brief update data
+   * interceptor runs on the value of key, if there is one, in a single
+   * locked pass (compute()); an absent key stays absent.
+   *
+   * @param key
+   * @param interceptor
+   * @return tl::optional<_Tp> nullopt
+   */
+  tl::optional<_Tp> operator()(_Key key, //
+                               std::function<void(_Tp &)> interceptor) {
+    return operator()(hashed(key), interceptor);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  tl::optional<_Tp> operator()(_Key key, _F interceptor) {
+    return operator()(hashed(key), std::move(interceptor));
+  }
+
+  tl::optional<_Tp> operator()(const hashed_key &hk,
+                               std::function<void(_Tp &)> interceptor) {
+    return _update(hk, interceptor);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  tl::optional<_Tp> operator()(const hashed_key &hk, _F interceptor) {
+    return _update(hk, interceptor);
+  }
+
+  /**
+   * @brief insert data
+   *
+   * @param key
+   * @param tp
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp> operator()(_Key key, _Tp &tp) {
+    return operator()(key, tl::make_optional<_Tp>(tp));
+  }
+
+  /**
+   * @brief insert or update data (Lvalue)
+   *
+   * @param tp
+   * @param interceptor
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp>
+  operator()(_Tp &tp, //
+             std::function<void(_Tp &)> interceptor = nullptr) {
+    return _insert_copied(tp, interceptor);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  tl::optional<_Tp> operator()(_Tp &tp, _F interceptor) {
+    return _insert_copied(tp, interceptor);
+  }
+
+  /**
+   * @brief insert or update data (Rvalue)
+   *
+   * @param tp
+   * @param interceptor
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp>
+  operator()(_Tp &&tp, //
+             std::function<void(_Tp &)> interceptor = nullptr) {
+    return _insert_moved(std::move(tp), interceptor);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  tl::optional<_Tp> operator()(_Tp &&tp, _F interceptor) {
+    return _insert_moved(std::move(tp), interceptor);
+  }
+
+  /**
+   * @brief insert _Tp(args...) for key, constructed in place in the table
+   * nothing is constructed if key is there already. works with a
+   * move-only _Tp.
+   * ex) hash.try_emplace(key, key, std::move(buffer));
+   *
+   * @param key
+   * @param args  arguments of a _Tp constructor
+   * @return true  inserted; false if key is there, or if the shard is full
+   * inside a callback (see LockedHashOutcome::full)
+   */
+  template <typename... _Args> bool try_emplace(_Key key, _Args &&...args) {
+    return _self()._emplace(key, _hash(key), std::forward<_Args>(args)...);
+  }
+
+  template <typename... _Args>
+  bool try_emplace(const hashed_key &hk, _Args &&...args) {
+    return _self()._emplace(hk.key, hk.hash, std::forward<_Args>(args)...);
+  }
+
+  /**
+   * @brief insert _Tp(args...)
+   * the key is made from the value, so the value is built once and moved
+   * into the table (try_emplace builds it in place).
+   *
+   * @param args  arguments of a _Tp constructor
+   * @return true  inserted (see try_emplace)
+   */
+  template <typename... _Args> bool emplace(_Args &&...args) {
+    _Tp tp(std::forward<_Args>(args)...);
+    _Key key = _makekey(tp);
+    return _self()._emplace(key, _hash(key), std::move(tp));
+  }
+
+  /**
+   * @brief insert or update or search
+   * with LockedHashSwiss and LockedHashCuckoo, an insert made from inside
+   * a callback of the same shard is dropped if the shard is full, since it
+   * can not grow under the walk; it returns nullopt like an update does.
+   * use compute() to tell the two apart (LockedHashOutcome::full).
+   * a tp whose own key (_MakeKey) is not key is not inserted: it could
+   * never be found by either key.
+   *
+   * @param key
+   * @param tp
+   * @param interceptor
+   * @return tl::optional<_Tp> the inserted value, or the value found if tp
+   * is empty; nullopt otherwise
+   */
+  tl::optional<_Tp>
+  operator()(_Key key,             //
+             tl::optional<_Tp> tp, //
+             std::function<void(_Tp &)> interceptor = nullptr) {
+    if (!_owns(key, tp)) {
+      return tl::nullopt;
+    }
+    return _self()._insert(key, _hash(key), tp, interceptor);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  tl::optional<_Tp> operator()(_Key key, tl::optional<_Tp> tp,
+                               _F interceptor) {
+    if (!_owns(key, tp)) {
+      return tl::nullopt;
+    }
+    return _self()._insert(key, _hash(key), tp, interceptor);
+  }
+
+  tl::optional<_Tp>
+  operator()(const hashed_key &hk, //
+             tl::optional<_Tp> tp, //
+             std::function<void(_Tp &)> interceptor = nullptr) {
+    if (!_owns(hk.key, tp)) {
+      return tl::nullopt;
+    }
+    return _self()._insert(hk.key, hk.hash, tp, interceptor);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  tl::optional<_Tp> operator()(const hashed_key &hk, tl::optional<_Tp> tp,
+                               _F interceptor) {
+    if (!_owns(hk.key, tp)) {
+      return tl::nullopt;
+    }
+    return _self()._insert(hk.key, hk.hash, tp, interceptor);
+  }
+
+  /**
+   * @brief insert, update or remove the value of key in one locked pass
+   * fn gets the LockedHashEntry of key: empty if key is absent. it may
+   * change the value, emplace one, or erase it. with
+   * LockedHashSplitOrdered fn runs again if a concurrent writer changed
+   * the entry first.
+   *
+   * @param key
+   * @param fn   void fn(LockedHashEntry<_Tp> &), or _R fn(...)
+   * @return LockedHashOutcome what happened to key; full if the value fn
+   * emplaced did not fit
+   */
+  template <typename _F, typename _R = _result_t<_F, LockedHashEntry<_Tp>>,
+            typename std::enable_if<std::is_void<_R>::value, int>::type = 0>
+  LockedHashOutcome compute(_Key key, _F fn) {
+    return _self()._compute(key, _hash(key), fn);
+  }
+
+  template <typename _F, typename _R = _result_t<_F, LockedHashEntry<_Tp>>,
+            typename std::enable_if<std::is_void<_R>::value, int>::type = 0>
+  LockedHashOutcome compute(const hashed_key &hk, _F fn) {
+    return _self()._compute(hk.key, hk.hash, fn);
+  }
+
+  /**
+   * @brief compute() with a result
+   *
+   * @return std::pair<LockedHashOutcome, _R> what happened to key, and
+   * what fn returned (its last run)
+   */
+  template <typename _F, typename _R = _result_t<_F, LockedHashEntry<_Tp>>,
+            typename std::enable_if<!std::is_void<_R>::value, int>::type = 0>
+  std::pair<LockedHashOutcome, _R> compute(_Key key, _F fn) {
+    return compute(hashed(key), std::move(fn));
+  }
+
+  template <typename _F, typename _R = _result_t<_F, LockedHashEntry<_Tp>>,
+            typename std::enable_if<!std::is_void<_R>::value, int>::type = 0>
+  std::pair<LockedHashOutcome, _R> compute(const hashed_key &hk, _F fn) {
+    tl::optional<_R> ret;
+    auto f = [&ret, &fn](LockedHashEntry<_Tp> &e) { ret = fn(e); };
+    LockedHashOutcome outcome = _self()._compute(hk.key, hk.hash, f);
+    return std::pair<LockedHashOutcome, _R>(outcome, std::move(*ret));
+  }
+
+  /**
+   * @brief insert tp, or merge it into the value of its key
+   * ex) hash.merge(Counter(key, 1), [](Counter &cur, Counter &add) { //
+   *       cur.n += add.n;
+   *     });
+   *
+   * @param tp
+   * @param fn  void fn(_Tp &current, _Tp &tp)
+   * @return LockedHashOutcome inserted or updated (or full, see compute)
+   */
+  template <typename _F, _if_callable<_F, _Tp &, _Tp &> = 0>
+  LockedHashOutcome merge(_Tp tp, _F fn) {
+    typedef std::integral_constant<bool, _Derived::_compute_retries> retries;
+    _Key key = _makekey(tp);
+    auto f = [&tp, &fn](LockedHashEntry<_Tp> &e) {
+      if (e) {
+        fn(*e, tp);
+      } else {
+        _merge_new(e, tp, retries());
+      }
+    };
+    return _self()._compute(key, _hash(key), f);
+  }
+
+  /**
+   * @brief rm(tp) - remove Lvalue
+   *
+   * @param tp
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp> rm(_Tp &tp) { //
+    return rm(_makekey(tp));
+  }
+
+  /**
+   * @brief remove data for Rvalue
+   *
+   * @param tp
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp> rm(_Tp &&tp) { //
+    return rm(_makekey(tp));
+  }
+
+  /**
+   * @brief remove data for key
+   * rmf가 false를 반환하면 삭제하지 않는다.
+   *
+   * @param key
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp> rm(_Key key, std::function<bool(_Tp &tp)> rmf = nullptr) {
+    return _self()._rm(key, _hash(key), rmf);
+  }
+
+  template <typename _K, _if_transparent<_K> = 0>
+  tl::optional<_Tp> rm(const _K &key,
+                       std::function<bool(_Tp &tp)> rmf = nullptr) {
+    return _self()._rm(key, _hash(key), rmf);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  tl::optional<_Tp> rm(_Key key, _F rmf) {
+    return _self()._rm(key, _hash(key), rmf);
+  }
+
+  tl::optional<_Tp> rm(const hashed_key &hk,
+                       std::function<bool(_Tp &tp)> rmf = nullptr) {
+    return _self()._rm(hk.key, hk.hash, rmf);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  tl::optional<_Tp> rm(const hashed_key &hk, _F rmf) {
+    return _self()._rm(hk.key, hk.hash, rmf);
+  }
+
+  template <typename _K, typename _F, _if_transparent<_K> = 0,
+            _if_callable<_F, _Tp &> = 0>
+  tl::optional<_Tp> rm(const _K &key, _F rmf) {
+    return _self()._rm(key, _hash(key), rmf);
+  }
+
+  void find(_Key key, std::function<void(_Tp &tp)> findf) {
+    _self()._find(key, _hash(key), findf);
+  }
+
+  template <typename _K, _if_transparent<_K> = 0>
+  void find(const _K &key, std::function<void(_Tp &tp)> findf) {
+    _self()._find(key, _hash(key), findf);
+  }
+
+  void find(_Tp &&tp, std::function<void(_Tp &tp)> findf) { //
+    return find(_makekey(tp), findf);
+  }
+
+  void find(_Tp &tp, std::function<void(_Tp &tp)> findf) { //
+    return find(_makekey(tp), findf);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  void find(_Key key, _F findf) {
+    _self()._find(key, _hash(key), findf);
+  }
+
+  void find(const hashed_key &hk, std::function<void(_Tp &tp)> findf) {
+    _self()._find(hk.key, hk.hash, findf);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  void find(const hashed_key &hk, _F findf) {
+    _self()._find(hk.key, hk.hash, findf);
+  }
+
+  template <typename _K, typename _F, _if_transparent<_K> = 0,
+            _if_callable<_F, _Tp &> = 0>
+  void find(const _K &key, _F findf) {
+    _self()._find(key, _hash(key), findf);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  void find(_Tp &&tp, _F findf) {
+    _self()._find(_makekey(tp), _hash(_makekey(tp)), findf);
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &> = 0>
+  void find(_Tp &tp, _F findf) {
+    _self()._find(_makekey(tp), _hash(_makekey(tp)), findf);
+  }
+
+  /**
+   * @brief read-only find
+   * takes the bucket lock shared (LockedHashSharedLock), so readers of a
+   * bucket run in parallel. findf must not modify the table.
+   *
+   * @param key
+   * @param findf
+   */
+  void find_shared(_Key key, std::function<void(const _Tp &tp)> findf) {
+    _self()._find_shared(key, _hash(key), findf);
+  }
+
+  template <typename _K, _if_transparent<_K> = 0>
+  void find_shared(const _K &key, std::function<void(const _Tp &tp)> findf) {
+    _self()._find_shared(key, _hash(key), findf);
+  }
+
+  template <typename _F, _if_callable<_F, const _Tp &> = 0>
+  void find_shared(_Key key, _F findf) {
+    _self()._find_shared(key, _hash(key), findf);
+  }
+
+  void find_shared(const hashed_key &hk,
+                   std::function<void(const _Tp &tp)> findf) {
+    _self()._find_shared(hk.key, hk.hash, findf);
+  }
+
+  template <typename _F, _if_callable<_F, const _Tp &> = 0>
+  void find_shared(const hashed_key &hk, _F findf) {
+    _self()._find_shared(hk.key, hk.hash, findf);
+  }
+
+  template <typename _K, typename _F, _if_transparent<_K> = 0,
+            _if_callable<_F, const _Tp &> = 0>
+  void find_shared(const _K &key, _F findf) {
+    _self()._find_shared(key, _hash(key), findf);
+  }
+
+  /**
+   * @brief find without copying: projects the value with f under the
+   * bucket lock and returns what f returns
+   * ex) tl::optional<int> age = hash.apply(key, [](Person &p) { //
+   *       return p.age;
+   *     });
+   *
+   * @param key
+   * @param f      _R f(_Tp &)
+   * @return tl::optional<_R> tl::nullopt if key is not found
+   */
+  template <typename _F, typename _R = _result_t<_F, _Tp>>
+  tl::optional<_R> apply(_Key key, _F f) {
+    return _apply(key, _hash(key), f);
+  }
+
+  template <typename _K, typename _F, _if_transparent<_K> = 0,
+            typename _R = _result_t<_F, _Tp>>
+  tl::optional<_R> apply(const _K &key, _F f) {
+    return _apply(key, _hash(key), f);
+  }
+
+  template <typename _F, typename _R = _result_t<_F, _Tp>>
+  tl::optional<_R> apply(const hashed_key &hk, _F f) {
+    return _apply(hk.key, hk.hash, f);
+  }
+
+  /**
+   * @brief read-only apply (find_shared)
+   *
+   * @param key
+   * @param f      _R f(const _Tp &)
+   * @return tl::optional<_R> tl::nullopt if key is not found
+   */
+  template <typename _F, typename _R = _result_t<_F, const _Tp>>
+  tl::optional<_R> apply_shared(_Key key, _F f) {
+    return _apply_shared(key, _hash(key), f);
+  }
+
+  template <typename _K, typename _F, _if_transparent<_K> = 0,
+            typename _R = _result_t<_F, const _Tp>>
+  tl::optional<_R> apply_shared(const _K &key, _F f) {
+    return _apply_shared(key, _hash(key), f);
+  }
+
+  template <typename _F, typename _R = _result_t<_F, const _Tp>>
+  tl::optional<_R> apply_shared(const hashed_key &hk, _F f) {
+    return _apply_shared(hk.key, hk.hash, f);
+  }
+
+  /**
+   * @brief the value in place, locked until the accessor is destroyed
+   * (LockedHashAccessor). no copy of _Tp is made.
+   * not available with LockedHashEpochLock and LockedHashSplitOrdered,
+   * whose values are replaced instead of changed in place.
+   *
+   * @param key
+   * @return accessor  empty if key is not found
+   */
+  auto access(_Key key) { //
+    return _self()._access(key, _hash(key));
+  }
+
+  template <typename _K, _if_transparent<_K> = 0>
+  auto access(const _K &key) {
+    return _self()._access(key, _hash(key));
+  }
+
+  auto access(const hashed_key &hk) { //
+    return _self()._access(hk.key, hk.hash);
+  }
+
+  /**
+   * @brief read-only access
+   * holds the bucket lock shared (LockedHashSharedLock), or an epoch
+   * (LockedHashSplitOrdered).
+   *
+   * @param key
+   * @return const_accessor  empty if key is not found
+   */
+  auto access_shared(_Key key) { //
+    return _self()._access_shared(key, _hash(key));
+  }
+
+  template <typename _K, _if_transparent<_K> = 0>
+  auto access_shared(const _K &key) {
+    return _self()._access_shared(key, _hash(key));
+  }
+
+  auto access_shared(const hashed_key &hk) { //
+    return _self()._access_shared(hk.key, hk.hash);
+  }
+
+  /**
+   * @brief expire_time 이상 업데이트 되지 않은 Node를 삭제한다.
+   * expire_time이 0일 경우, 동작하지 않음.
+   *
+   * @return tl::optional<std::list<_Tp>> 삭제된 내용이 있으면 list, 없으면
+   * tl::nullopt를 반환.
+   */
+  tl::optional<std::list<_Tp>> expire(                                        //
+      std::function<bool(_Tp &, time_t timestamp, void *)> expiref = nullptr, //
+      void *arg = nullptr) {                                                  //
+    return expiref ? _self()._expire(expiref, arg) : _self()._expire();
+  }
+
+  template <typename _F, _if_callable<_F, _Tp &, time_t, void *> = 0>
+  tl::optional<std::list<_Tp>> expire(_F expiref, void *arg = nullptr) {
+    return _self()._expire(expiref, arg);
+  }
+
+  /**
+   * @brief loop(lambda loop function)
+   * loopf 결과가 true인 경우 Node의 timestamp를 업데이트 한다.
+   *
+   * @param loopf  bool loopf(size_t bucket, time_t timestamp, _Tp &tp)
+   */
+  void
+  loop(std::function<bool(size_t bucket, time_t timestamp, _Tp &tp)> loopf) {
+    _self()._loop(loopf);
+  }
+
+  template <typename _F, _if_callable<_F, size_t, time_t, _Tp &> = 0>
+  void loop(_F loopf) {
+    _self()._loop(loopf);
+  }
+
+  /**
+   * @brief loop_shared(lambda read-only loop function)
+   * loop under a shared lock (LockedHashSharedLock); loopf only reads and
+   * must not modify the table.
+   *
+   * @param loopf  void loopf(size_t bucket, time_t timestamp, const _Tp &tp)
+   */
+  void loop_shared(
+      std::function<void(size_t bucket, time_t timestamp, const _Tp &tp)>
+          loopf) {
+    _self()._loop_shared(loopf);
+  }
+
+  template <typename _F, _if_callable<_F, size_t, time_t, const _Tp &> = 0>
+  void loop_shared(_F loopf) {
+    _self()._loop_shared(loopf);
+  }
+
+  /**
+   * @brief loop_with_delete(lambda loop function)
+   * loopf 결과가 true인 경우 Node를 제거한다.
+   *
+   * @param loopf  bool loopf(size_t bucket, time_t timestamp, _Tp &tp)
+   */
+  void loop_with_delete(
+      std::function<bool(size_t bucket, time_t timestamp, _Tp &tp)> loopf) {
+    _self()._loop_with_delete(loopf);
+  }
+
+  template <typename _F, _if_callable<_F, size_t, time_t, _Tp &> = 0>
+  void loop_with_delete(_F loopf) {
+    _self()._loop_with_delete(loopf);
+  }
+
+  /**
+   * @brief showdata(lambda show function)
+   * showdataf must not modify tp.
+   *
+   * @param showdataf  void showdataf(size_t bucket, _Tp &tp)
+   */
+  void showdata(std::function<void(size_t bucket, _Tp &tp)> showdataf) {
+    _self()._showdata(showdataf);
+  }
+
+  template <typename _F, _if_callable<_F, size_t, _Tp &> = 0>
+  void showdata(_F showdataf) {
+    _self()._showdata(showdataf);
+  }
+
+  /**
+   * @brief elements of each bucket
+   *
+   * @param showdataf  void showdataf(size_t bucket, size_t cnt)
+   */
+  void showbucket(std::function<void(size_t bucket, size_t cnt)> showdataf) {
+    _self()._showbucket(showdataf);
+  }
+
+  template <typename _F, _if_callable<_F, size_t, size_t> = 0>
+  void showbucket(_F showdataf) {
+    _self()._showbucket(showdataf);
+  }
+
+  /**
+   * @brief (life)timestamp update
+   *
+   * @param key
+   * @return tl::optional<_Tp>
+   */
+  tl::optional<_Tp> //
+  alive(_Key &key) {
+    return _self()._alive(key, _hash(key));
+  }
+
+  tl::optional<_Tp> //
+  alive(_Key &&key) {
+    return alive(key);
+  }
+
+  template <typename _K, _if_transparent<_K> = 0>
+  tl::optional<_Tp> //
+  alive(const _K &key) {
+    return _self()._alive(key, _hash(key));
+  }
+
+  tl::optional<_Tp> //
+  alive(const hashed_key &hk) {
+    return _self()._alive(hk.key, hk.hash);
+  }
+
+  /**
+   * @brief search n keys at once
+   * the keys are grouped by lock stripe, and each stripe is locked once
+   * for all of its keys (see _batch).
+   *
+   * @param keys
+   * @param n
+   * @param out  n values: out[i] is the value of keys[i], or tl::nullopt
+   * @return size_t keys found
+   */
+  size_t multi_get(const _Key *keys, size_t n, tl::optional<_Tp> *out) {
+    size_t found = 0;
+    std::function<void(_Tp &)> interceptor = nullptr;
+    _batch(n, true, keys, [&](size_t i, size_t hash) {
+      tl::optional<_Tp> tp = tl::nullopt;
+      out[i] = _self()._insert(keys[i], hash, tp, interceptor);
+      found += out[i].has_value();
+    });
+    return found;
+  }
+
+  /**
+   * @brief insert copies of n values at once; a value whose key is there
+   * already is not inserted (as try_emplace)
+   *
+   * @param tps
+   * @param n
+   * @param inserted  nullptr, or n flags: tps[i] was inserted
+   * @return size_t values inserted
+   */
+  size_t multi_insert(const _Tp *tps, size_t n, bool *inserted = nullptr) {
+    size_t count = 0;
+    auto keyof = [this, tps](size_t i) { return _makekey(tps[i]); };
+    _batch(n, false, keyof, [&](size_t i, size_t hash) {
+      bool ok = _self()._emplace(_makekey(tps[i]), hash, tps[i]);
+      if (inserted) {
+        inserted[i] = ok;
+      }
+      count += ok;
+    });
+    return count;
+  }
+
+  /**
+   * @brief remove n keys at once
+   *
+   * @param keys
+   * @param n
+   * @param out  nullptr, or n values: the removed value of keys[i], or
+   *             tl::nullopt
+   * @return size_t keys removed
+   */
+  size_t multi_rm(const _Key *keys, size_t n,
+                  tl::optional<_Tp> *out = nullptr) {
+    size_t count = 0;
+    std::function<bool(_Tp &)> rmf = nullptr;
+    _batch(n, false, keys, [&](size_t i, size_t hash) {
+      tl::optional<_Tp> tp = _self()._rm(keys[i], hash, rmf);
+      count += tp.has_value();
+      if (out) {
+        out[i] = std::move(tp);
+      }
+    });
+    return count;
+  }
+
+  /**
+   * @brief update the values of n keys at once, as compute() with fn
+   * called only on a key that is there
+   * ex) hash.multi_update(keys, n, [&](size_t i, Counter &c) { //
+   *       c.n += deltas[i];
+   *     });
+   *
+   * @param keys
+   * @param n
+   * @param fn       void fn(size_t i, _Tp &tp): tp is the value of keys[i]
+   * @param updated  nullptr, or n flags: keys[i] was there
+   * @return size_t keys updated
+   */
+  template <typename _F, _if_callable<_F, size_t, _Tp &> = 0>
+  size_t multi_update(const _Key *keys, size_t n, _F fn,
+                      bool *updated = nullptr) {
+    size_t count = 0;
+    _batch(n, false, keys, [&](size_t i, size_t hash) {
+      auto f = [&fn, i](LockedHashEntry<_Tp> &e) {
+        if (e) {
+          fn(i, *e);
+        }
+      };
+      bool ok = _self()._compute(keys[i], hash, f) ==
+                LockedHashOutcome::updated;
+      if (updated) {
+        updated[i] = ok;
+      }
+      count += ok;
+    });
+    return count;
+  }
+
+private:
+  /**
+   * @brief call op(i, hash) for i in [0, n), grouped by lock stripe
+   * LOCKEDHASH_BATCH_KEYS keys at a time are hashed and sorted by stripe
+   * (_sort_stripes);
+   * each stripe is then locked once for all of its keys. one stripe is
+   * held at a time, taken in increasing order, so batches never deadlock
+   * each other. the cores op calls take the held lock again, which only
+   * counts a recursion.
+   *
+   * the lookups are software pipelined: while key j is worked on, the
+   * bucket of key j + 2 * LOCKEDHASH_PREFETCH_DISTANCE and the first node
+   * of key j + LOCKEDHASH_PREFETCH_DISTANCE are on their way from memory,
+   * so the cache misses of many keys overlap.
+   *
+   * @param n
+   * @param shared  op only reads
+   * @param keyof   the keys (const _Key *), or key of i (keyof(i))
+   * @param op
+   */
+  template <typename _KeyOf, typename _Op>
+  void _batch(size_t n, bool shared, _KeyOf &keyof, _Op op) {
+    static_assert(LOCKEDHASH_BATCH_KEYS <= (1 << 16), "16 bit key index");
+    // stripe << 16 | index in the chunk
+    uint64_t keys[LOCKEDHASH_BATCH_KEYS], tmp[LOCKEDHASH_BATCH_KEYS];
+    size_t hashes[LOCKEDHASH_BATCH_KEYS];
+    const size_t d = LOCKEDHASH_PREFETCH_DISTANCE;
+
+    for (size_t first = 0; first < n; first += LOCKEDHASH_BATCH_KEYS) {
+      size_t m = std::min(n - first, (size_t)LOCKEDHASH_BATCH_KEYS);
+      _hash_chunk(keyof, first, m, hashes);
+      size_t top = 0;
+      for (size_t j = 0; j < m; j++) {
+        size_t stripe = _self()._stripe(hashes[j]);
+        keys[j] = (uint64_t)stripe << 16 | j;
+        top |= stripe;
+      }
+      const uint64_t *order = _sort_stripes(keys, tmp, m, top);
+
+      auto hash_at = [&](size_t j) { return hashes[order[j] & 0xffff]; };
+      for (size_t j = 0; j < 2 * d && j < m; j++) {
+        _self()._prefetch(hash_at(j), 0);
+      }
+      for (size_t j = 0; j < d && j < m; j++) {
+        _self()._prefetch(hash_at(j), 1);
+      }
+      auto run = [&](size_t j) {
+        if (d > 0 && j + 2 * d < m) {
+          _self()._prefetch(hash_at(j + 2 * d), 0);
+        }
+        if (d > 0 && j + d < m) {
+          _self()._prefetch(hash_at(j + d), 1);
+        }
+        op(first + (order[j] & 0xffff), hash_at(j));
+      };
+
+      for (size_t j = 0; j < m;) {
+        size_t end = j + 1;
+        while (end < m && order[end] >> 16 == order[j] >> 16) {
+          end++;
+        }
+        if (end - j == 1) {
+          // a lone key: its core takes the lock anyway
+          run(j++);
+          continue;
+        }
+        {
+          auto guard = _self()._lock_stripe(hash_at(j), shared);
+          for (; j < end; j++) {
+            run(j);
+          }
+        }
+        if (!shared) {
+          _self()._batch_end();
+        }
+      }
+    }
+  }
+
+  static const _Key &_key_at(const _Key *keys, size_t i) { //
+    return keys[i];
+  }
+
+  template <typename _KeyOf>
+  static auto _key_at(_KeyOf &keyof, size_t i) -> decltype(keyof(i)) {
+    return keyof(i);
+  }
+
+  /**
+   * @brief hashes[j] = hash of key first + j, j < m
+   * by _KeyHash::batch if it has one (LockedHashIntHash,
+   * LockedHashBytesHash), else key by key.
+   */
+  template <typename _KeyOf>
+  void _hash_chunk(_KeyOf &keyof, size_t first, size_t m, size_t *hashes) {
+    _hash_chunk(keyof, first, m, hashes,
+                LockedHashIsBatchHash<_KeyHash, _Key>());
+  }
+
+  void _hash_chunk(const _Key *keys, size_t first, size_t m, size_t *hashes,
+                   std::true_type) {
+    _hash.batch(keys + first, m, hashes);
+  }
+
+  /// keys made one by one (multi_insert): gathered first if small and
+  /// trivially copyable
+  template <typename _KeyOf>
+  void _hash_chunk(_KeyOf &keyof, size_t first, size_t m, size_t *hashes,
+                   std::true_type) {
+    typedef std::integral_constant<
+        bool, std::is_trivially_copyable<_Key>::value && sizeof(_Key) <= 64>
+        gather;
+    _hash_chunk(keyof, first, m, hashes, std::true_type(), gather());
+  }
+
+  template <typename _KeyOf>
+  void _hash_chunk(_KeyOf &keyof, size_t first, size_t m, size_t *hashes,
+                   std::true_type, std::true_type) {
+    typename std::aligned_storage<sizeof(_Key), alignof(_Key)>::type
+        buf[LOCKEDHASH_BATCH_KEYS];
+    _Key *keys = reinterpret_cast<_Key *>(buf);
+    for (size_t j = 0; j < m; j++) {
+      new (&keys[j]) _Key(_key_at(keyof, first + j));
+    }
+    _hash.batch((const _Key *)keys, m, hashes);
+  }
+
+  template <typename _KeyOf>
+  void _hash_chunk(_KeyOf &keyof, size_t first, size_t m, size_t *hashes,
+                   std::true_type, std::false_type) {
+    _hash_chunk(keyof, first, m, hashes, std::false_type());
+  }
+
+  template <typename _KeyOf>
+  void _hash_chunk(_KeyOf &keyof, size_t first, size_t m, size_t *hashes,
+                   std::false_type) {
+    for (size_t j = 0; j < m; j++) {
+      hashes[j] = _hash(_key_at(keyof, first + j));
+    }
+  }
+
+  /**
+   * @brief sort stripe << 16 | index by stripe: LSD radix sort, 8 bits
+   * a pass over the bits set in top (no pass if every stripe is 0).
+   * stable, so the keys of a stripe keep their input order.
+   *
+   * @return uint64_t* keys or tmp, whichever holds the result
+   */
+  static uint64_t *_sort_stripes(uint64_t *keys, uint64_t *tmp, size_t m,
+                                 size_t top) {
+    for (size_t shift = 16; top; shift += 8, top >>= 8) {
+      size_t count[257] = {0};
+      for (size_t j = 0; j < m; j++) {
+        count[((keys[j] >> shift) & 0xff) + 1]++;
+      }
+      for (size_t b = 1; b < 257; b++) {
+        count[b] += count[b - 1];
+      }
+      for (size_t j = 0; j < m; j++) {
+        tmp[count[(keys[j] >> shift) & 0xff]++] = keys[j];
+      }
+      std::swap(keys, tmp);
+    }
+    return keys;
+  }
+
+  static void _merge_new(LockedHashEntry<_Tp> &e, _Tp &tp, std::false_type) {
+    e.emplace(std::move(tp));
+  }
+
+  /// a rerun of merge's fn may still need tp
+  static void _merge_new(LockedHashEntry<_Tp> &e, _Tp &tp, std::true_type) {
+    e.emplace(tp);
+  }
+
+  /// operator()(key, interceptor): compute() that only changes a value
+  template <typename _F>
+  tl::optional<_Tp> _update(const hashed_key &hk, _F &interceptor) {
+    if (!LockedHashCallback::set(interceptor)) {
+      return tl::nullopt;
+    }
+    auto f = [&interceptor](LockedHashEntry<_Tp> &e) {
+      if (e) {
+        interceptor(*e);
+      }
+    };
+    _self()._compute(hk.key, hk.hash, f);
+    return tl::nullopt;
+  }
+
+  template <typename _F>
+  tl::optional<_Tp> _insert_copied(_Tp &tp, _F &interceptor) {
+    _Key key = _makekey(tp);
+    tl::optional<_Tp> copied(tp);
+    return _self()._insert(key, _hash(key), copied, interceptor);
+  }
+
+  /// true if tp is empty or its own key is key
+  bool _owns(const _Key &key, const tl::optional<_Tp> &tp) {
+    return !tp.has_value() || _keyequal(_makekey(*tp), key);
+  }
+
+  /// the key is copied first: _makekey may return a reference into tp
+  template <typename _F>
+  tl::optional<_Tp> _insert_moved(_Tp &&tp, _F &interceptor) {
+    _Key key = _makekey(tp);
+    tl::optional<_Tp> moved(std::move(tp));
+    return _self()._insert(key, _hash(key), moved, interceptor);
+  }
+
+  template <typename _K, typename _F, typename _R = _result_t<_F, _Tp>>
+  tl::optional<_R> _apply(const _K &key, size_t hash, _F &f) {
+    tl::optional<_R> ret;
+    auto findf = [&ret, &f](_Tp &tp) { ret = f(tp); };
+    _self()._find(key, hash, findf);
+    return ret;
+  }
+
+  template <typename _K, typename _F,
+            typename _R = _result_t<_F, const _Tp>>
+  tl::optional<_R> _apply_shared(const _K &key, size_t hash, _F &f) {
+    tl::optional<_R> ret;
+    auto findf = [&ret, &f](const _Tp &tp) { ret = f(tp); };
+    _self()._find_shared(key, hash, findf);
+    return ret;
+  }
+};
+
+#endif
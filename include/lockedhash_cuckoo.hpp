@@ -0,0 +1,902 @@
+#ifndef __LOCKED_HASH_CUCKOO_HPP__
+#define __LOCKED_HASH_CUCKOO_HPP__
+
+#include <atomic>
+#include <lockedhash_base.hpp>
+#include <lockedhash_hash.hpp>
+#include <lockedhash_lock.hpp>
+#include <mutex>
+#include <new>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+/// slots per bucket
+#define LOCKEDHASH_CUCKOO_WAYS 4
+/// slots per shard used to size the shards from bucket_size
+#define LOCKEDHASH_CUCKOO_SHARD_SLOTS 1024
+/// maximum displacements of one insert (BFS depth) before the shard grows
+#define LOCKEDHASH_CUCKOO_MAX_PATH 5
+
+/**
+ * @brief LockedHash (LockedHashCuckoo storage)
+ *
+ * Bucketized cuckoo hashing: a key lives in one of 4 slots of one of two
+ * buckets. The second bucket is derived from the first and an 8-bit tag of
+ * the hash (partial-key cuckoo), so entries are displaced without hashing
+ * their keys again. A lookup reads the tags of two buckets and touches a
+ * slot only on a tag match.
+ *
+ * When both buckets of a new key are full, a breadth-first search looks for
+ * a short chain of displacements (LOCKEDHASH_CUCKOO_MAX_PATH) that ends in
+ * a free slot. The shard only doubles when no such chain exists, which
+ * keeps shards above 90% full. Entries are stored inline, so no entry is
+ * allocated on its own.
+ *
+ * Keys whose buckets stay full though the shard is at most half full
+ * (many keys of one hash) go to the stash of the shard instead: slots
+ * after the buckets, searched one by one, only when not empty.
+ *
+ * As with LockedHashSwiss, the table is split into shards, each with its
+ * own lock; both buckets of a key are in the same shard. "bucket" in the
+ * callbacks is the shard. A callback that inserts into the shard it was
+ * called for does not displace or grow: the insert fails if both buckets
+ * are full.
+ *
+ * @tparam _Key      Type of key objects.
+ * @tparam _Tp       Type of mapped objects.
+ * @tparam _Hash     Hashing function object type
+ * @tparam _MakeKey  Make Key function object type
+ * @tparam _KeyEqual Key equality function object type
+ * @tparam _KeyHash  Key hashing function object type
+ * @tparam _Alloc    Allocator type (rebound to the slot arrays)
+ */
+template <typename _Key, typename _Tp, typename _Hash, typename _MakeKey,
+          typename _KeyEqual, typename _KeyHash, typename _Alloc>
+class LockedHash<_Key, _Tp, _Hash, _MakeKey, LockedHashCuckoo, _KeyEqual,
+                 _KeyHash, _Alloc>
+    : public LockedHashBase<LockedHash<_Key, _Tp, _Hash, _MakeKey,
+                                       LockedHashCuckoo, _KeyEqual, _KeyHash,
+                                       _Alloc>,
+                            _Key, _Tp, _MakeKey, _KeyEqual, _KeyHash> {
+private:
+  typedef LockedHashBase<LockedHash, _Key, _Tp, _MakeKey, _KeyEqual, _KeyHash>
+      _Base;
+  friend _Base;
+  using _Base::_hash;
+  using _Base::_makekey;
+  using _Base::_keyequal;
+
+private:
+  /**
+   * @brief LockedHashSlot
+   *
+   */
+  class LockedHashSlot {
+  public:
+    _Tp _tp;
+    time_t _timestamp = time(nullptr);
+
+    template <typename... _Args>
+    LockedHashSlot(_Args &&...args) : _tp(std::forward<_Args>(args)...) {}
+  };
+
+  typedef typename std::allocator_traits<_Alloc>::template rebind_alloc<
+      LockedHashSlot>
+      _SlotAlloc;
+  typedef std::allocator_traits<_SlotAlloc> _SlotTraits;
+
+  /**
+   * @brief LockedHashShard
+   * tags/slots are allocated on the first insert.
+   * tag 0 marks an empty slot.
+   */
+  class LockedHashShard {
+  public:
+    std::recursive_mutex lock;
+    /// recursion depth of lock (a shard is never changed under a walk)
+    size_t depth = 0;
+    uint8_t *tags = nullptr;
+    LockedHashSlot *slots = nullptr;
+    /// buckets (2^n)
+    size_t buckets = 0;
+    /// stash slots, after the buckets
+    size_t stash = 0;
+    size_t elements = 0;
+  };
+
+  class LockedHashGuard {
+  private:
+    LockedHashShard *_shard;
+
+  public:
+    LockedHashGuard(LockedHashShard &shard) : _shard(&shard) {
+      _shard->lock.lock();
+      _shard->depth++;
+    }
+    LockedHashGuard(LockedHashGuard &&o) : _shard(o._shard) {
+      o._shard = nullptr;
+    }
+    ~LockedHashGuard() { //
+      release();
+    }
+
+    void release() {
+      if (_shard) {
+        _shard->depth--;
+        _shard->lock.unlock();
+        _shard = nullptr;
+      }
+    }
+  };
+
+public:
+  /// value in place, shard lock held (access)
+  typedef LockedHashAccessor<_Tp, LockedHashGuard> accessor;
+  /// read-only value in place, shard lock held (access_shared)
+  typedef LockedHashAccessor<const _Tp, LockedHashGuard> const_accessor;
+
+private:
+
+  /// bucket reached by a displacement search
+  struct LockedHashStep {
+    size_t bucket;
+    /// step whose entry at slot moves into bucket (-1: first bucket)
+    int parent;
+    int slot;
+    int depth;
+  };
+
+  static const size_t NPOS = (size_t)-1;
+
+private:
+  /// slot array allocator
+  _SlotAlloc _alloc;
+  LockedHashStripes<LockedHashShard> _shards;
+  /// number of shards (power of 2)
+  size_t _shard_count;
+  size_t _shard_bits;
+  /// initial buckets of a shard
+  size_t _shard_buckets;
+  /// total elements
+  LockedHashCounter _size;
+
+  time_t _expire_time = 0;
+
+private:
+  static uint8_t _tag(size_t hash) {
+    uint8_t tag = (uint8_t)hash;
+    return tag ? tag : 1;
+  }
+
+  LockedHashShard &_get_shard(size_t hash) { //
+    return _shards.of(hash >> 8);
+  }
+
+  /// shard of hash (_Base::_batch)
+  size_t _stripe(size_t hash) {
+    return (LockedHashFmix::mix(hash) >> 8) & (_shard_count - 1);
+  }
+
+  /// shard lock of hash. depth is left alone: the cores called under it
+  /// may still grow the shard.
+  std::unique_lock<std::recursive_mutex> _lock_stripe(size_t hash, bool) {
+    return std::unique_lock<std::recursive_mutex>(
+        _get_shard(LockedHashFmix::mix(hash)).lock);
+  }
+
+  /// shard of hash, then its first bucket (read racily: only prefetched)
+  void _prefetch(size_t hash, int stage) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    if (stage == 0) {
+      LOCKEDHASH_PREFETCH(&sh);
+      return;
+    }
+    size_t buckets = LockedHashRacy::load(sh.buckets);
+    if (buckets == 0) {
+      return;
+    }
+    size_t b = ((hash >> (8 + _shard_bits)) & (buckets - 1)) *
+               LOCKEDHASH_CUCKOO_WAYS;
+    LOCKEDHASH_PREFETCH(LockedHashRacy::load(sh.tags) + b);
+    LOCKEDHASH_PREFETCH(LockedHashRacy::load(sh.slots) + b);
+  }
+
+  size_t _bucket(LockedHashShard &sh, size_t hash) {
+    return (hash >> (8 + _shard_bits)) & (sh.buckets - 1);
+  }
+
+  /// the other bucket of an entry with tag in bucket
+  static size_t _alt(LockedHashShard &sh, size_t bucket, uint8_t tag) {
+    return (bucket ^ ((size_t)tag * 0xc6a4a7935bd1e995ULL)) &
+           (sh.buckets - 1);
+  }
+
+  /// slots of the buckets
+  size_t _table(LockedHashShard &sh) { //
+    return sh.buckets * LOCKEDHASH_CUCKOO_WAYS;
+  }
+
+  /// all slots: the buckets and the stash
+  size_t _capacity(LockedHashShard &sh) { //
+    return _table(sh) + sh.stash;
+  }
+
+  /**
+   * @brief slot index of key in shard, NPOS if not found
+   */
+  template <typename _K>
+  size_t _find_slot(LockedHashShard &sh, const _K &key, size_t hash) {
+    if (sh.buckets == 0) {
+      return NPOS;
+    }
+    uint8_t tag = _tag(hash);
+    size_t b = _bucket(sh, hash);
+    for (int i = 0; i < 2; i++) {
+      for (size_t idx = b * LOCKEDHASH_CUCKOO_WAYS;
+           idx < (b + 1) * LOCKEDHASH_CUCKOO_WAYS; idx++) {
+        if (sh.tags[idx] == tag &&
+            _keyequal(_makekey(sh.slots[idx]._tp), key)) {
+          return idx;
+        }
+      }
+      b = _alt(sh, b, tag);
+    }
+    for (size_t idx = _table(sh); idx < _capacity(sh); idx++) {
+      if (sh.tags[idx] == tag &&
+          _keyequal(_makekey(sh.slots[idx]._tp), key)) {
+        return idx;
+      }
+    }
+    return NPOS;
+  }
+
+  /// free slot of bucket, NPOS if full
+  size_t _free_in(LockedHashShard &sh, size_t bucket) {
+    for (size_t idx = bucket * LOCKEDHASH_CUCKOO_WAYS;
+         idx < (bucket + 1) * LOCKEDHASH_CUCKOO_WAYS; idx++) {
+      if (sh.tags[idx] == 0) {
+        return idx;
+      }
+    }
+    return NPOS;
+  }
+
+  /// free slot of the stash, NPOS if full
+  size_t _free_stash(LockedHashShard &sh) {
+    for (size_t idx = _table(sh); idx < _capacity(sh); idx++) {
+      if (sh.tags[idx] == 0) {
+        return idx;
+      }
+    }
+    return NPOS;
+  }
+
+  void _move(LockedHashShard &sh, size_t from, size_t to) {
+    new (&sh.slots[to]) LockedHashSlot(std::move(sh.slots[from]));
+    sh.slots[from].~LockedHashSlot();
+    sh.tags[to] = sh.tags[from];
+    sh.tags[from] = 0;
+  }
+
+  /**
+   * @brief free a slot in bucket b1 or b2 by displacing entries along the
+   * shortest chain found (breadth-first)
+   *
+   * @return size_t the freed slot, NPOS if there is no chain
+   */
+  size_t _displace(LockedHashShard &sh, size_t b1, size_t b2) {
+    std::vector<LockedHashStep> steps;
+    steps.push_back(LockedHashStep{b1, -1, -1, 0});
+    if (b2 != b1) {
+      steps.push_back(LockedHashStep{b2, -1, -1, 0});
+    }
+    for (size_t i = 0; i < steps.size(); i++) {
+      LockedHashStep step = steps[i];
+      for (int s = 0; s < LOCKEDHASH_CUCKOO_WAYS; s++) {
+        size_t idx = step.bucket * LOCKEDHASH_CUCKOO_WAYS + s;
+        size_t alt = _alt(sh, step.bucket, sh.tags[idx]);
+        size_t empty = _free_in(sh, alt);
+        if (empty != NPOS) {
+          return _shift(sh, steps, i, s, empty);
+        }
+        if (step.depth + 1 < LOCKEDHASH_CUCKOO_MAX_PATH) {
+          steps.push_back(LockedHashStep{alt, (int)i, s, step.depth + 1});
+        }
+      }
+    }
+    return NPOS;
+  }
+
+  /**
+   * @brief move the entries of a chain, last one first, into the free slot
+   * ahead of it. a chain through the same bucket twice may go stale
+   * halfway; every move done so far is still valid.
+   */
+  size_t _shift(LockedHashShard &sh, std::vector<LockedHashStep> &steps,
+                size_t i, int s, size_t to) {
+    for (;;) {
+      size_t from = steps[i].bucket * LOCKEDHASH_CUCKOO_WAYS + s;
+      if (sh.tags[to] != 0 || sh.tags[from] == 0 ||
+          _alt(sh, steps[i].bucket, sh.tags[from]) !=
+              to / LOCKEDHASH_CUCKOO_WAYS) {
+        return NPOS;
+      }
+      _move(sh, from, to);
+      if (steps[i].parent < 0) {
+        return from;
+      }
+      to = from;
+      s = steps[i].slot;
+      i = steps[i].parent;
+    }
+  }
+
+  /// free slot for hash, NPOS if the shard has to grow
+  size_t _place(LockedHashShard &sh, size_t hash) {
+    if (sh.buckets == 0) {
+      return NPOS;
+    }
+    size_t b1 = _bucket(sh, hash);
+    size_t b2 = _alt(sh, b1, _tag(hash));
+    size_t idx = _free_in(sh, b1);
+    if (idx == NPOS) {
+      idx = _free_in(sh, b2);
+    }
+    if (idx == NPOS && sh.depth == 1) {
+      idx = _displace(sh, b1, b2);
+    }
+    return idx;
+  }
+
+  /// a full bucket pair grows the shard only if it is half full: keys of
+  /// one hash fill their buckets at any size
+  bool _can_grow(LockedHashShard &sh) {
+    return sh.buckets == 0 || sh.elements * 2 >= _table(sh);
+  }
+
+  /// tags and slots for _capacity(sh), all empty
+  void _allocate(LockedHashShard &sh) {
+    sh.tags = new uint8_t[_capacity(sh)];
+    memset(sh.tags, 0, _capacity(sh));
+    sh.slots = _SlotTraits::allocate(_alloc, _capacity(sh));
+  }
+
+  void _free(uint8_t *tags, LockedHashSlot *slots, size_t capacity) {
+    delete[] tags;
+    if (slots) {
+      _SlotTraits::deallocate(_alloc, slots, capacity);
+    }
+  }
+
+  /**
+   * @brief grow x2 and reinsert all slots; the entries that find no slot
+   * go to the stash
+   */
+  void _resize(LockedHashShard &sh) {
+    size_t capacity = _capacity(sh);
+    uint8_t *old_tags = sh.tags;
+    LockedHashSlot *old_slots = sh.slots;
+
+    sh.buckets = sh.buckets ? sh.buckets * 2 : _shard_buckets;
+    sh.stash = 0;
+    _allocate(sh);
+
+    std::vector<size_t> overflow;
+    for (size_t i = 0; i < capacity; i++) {
+      if (old_tags[i] == 0) {
+        continue;
+      }
+      size_t hash =
+          LockedHashFmix::mix(_hash(_makekey(old_slots[i]._tp)));
+      size_t idx = _place(sh, hash);
+      if (idx == NPOS) {
+        overflow.push_back(i);
+        continue;
+      }
+      new (&sh.slots[idx]) LockedHashSlot(std::move(old_slots[i]));
+      sh.tags[idx] = old_tags[i];
+      old_slots[i].~LockedHashSlot();
+    }
+    if (!overflow.empty()) {
+      _grow_stash(sh, overflow.size());
+    }
+    for (size_t i : overflow) {
+      size_t idx = _free_stash(sh);
+      new (&sh.slots[idx]) LockedHashSlot(std::move(old_slots[i]));
+      sh.tags[idx] = old_tags[i];
+      old_slots[i].~LockedHashSlot();
+    }
+    _free(old_tags, old_slots, capacity);
+  }
+
+  /**
+   * @brief room for at least extra more entries in the stash; the buckets
+   * stay as they are
+   */
+  void _grow_stash(LockedHashShard &sh, size_t extra) {
+    size_t capacity = _capacity(sh);
+    uint8_t *old_tags = sh.tags;
+    LockedHashSlot *old_slots = sh.slots;
+
+    size_t grow = std::max(sh.stash, (size_t)LOCKEDHASH_CUCKOO_WAYS);
+    sh.stash += std::max(extra, grow);
+    _allocate(sh);
+    for (size_t i = 0; i < capacity; i++) {
+      if (old_tags[i]) {
+        new (&sh.slots[i]) LockedHashSlot(std::move(old_slots[i]));
+        sh.tags[i] = old_tags[i];
+        old_slots[i].~LockedHashSlot();
+      }
+    }
+    _free(old_tags, old_slots, capacity);
+  }
+
+  /**
+   * @brief construct _Tp(args...) in one of its buckets
+   *
+   * @return size_t slot index, NPOS if both buckets and the stash are full
+   * and the shard can not change because a caller up the stack is walking
+   * it.
+   */
+  template <typename... _Args>
+  size_t _insert_slot(LockedHashShard &sh, size_t hash, _Args &&...args) {
+    size_t idx = _place(sh, hash);
+    if (idx == NPOS && sh.depth == 1 && _can_grow(sh)) {
+      _resize(sh);
+      idx = _place(sh, hash);
+    }
+    if (idx == NPOS) {
+      idx = _free_stash(sh);
+    }
+    if (idx == NPOS) {
+      if (sh.depth != 1 || sh.buckets == 0) {
+        return NPOS;
+      }
+      _grow_stash(sh, 1);
+      idx = _free_stash(sh);
+    }
+    new (&sh.slots[idx]) LockedHashSlot(std::forward<_Args>(args)...);
+    sh.tags[idx] = _tag(hash);
+    sh.elements++;
+    _size.add(1);
+    return idx;
+  }
+
+  void _erase_slot(LockedHashShard &sh, size_t idx) {
+    sh.slots[idx].~LockedHashSlot();
+    sh.tags[idx] = 0;
+    sh.elements--;
+    _size.add(-1);
+  }
+
+  /**
+   * @brief insert or update or search (core of operator())
+   *
+   * @param key
+   * @param hash  _hash(key)
+   * @param tp
+   * @param interceptor
+   * @return tl::optional<_Tp>
+   */
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _insert(const _K &key, size_t hash, //
+                            tl::optional<_Tp> &tp,      //
+                            _F &interceptor) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx != NPOS) {
+      LockedHashSlot &slot = sh.slots[idx];
+      if (!tp.has_value()) {
+        // only search
+        return tl::make_optional<_Tp>(slot._tp);
+      }
+      if (LockedHashCallback::set(interceptor)) {
+        // update data
+        interceptor(slot._tp);
+        slot._timestamp = time(nullptr);
+      }
+      return tl::nullopt;
+    }
+    if (!tp.has_value()) {
+      return tl::nullopt;
+    }
+
+    idx = _insert_slot(sh, hash, std::move(*tp));
+    if (idx == NPOS) {
+      return tl::nullopt;
+    }
+    return tl::make_optional<_Tp>(sh.slots[idx]._tp);
+  }
+
+  /// construct a value for key in place, unless key is there already
+  template <typename _K, typename... _Args>
+  bool _emplace(const _K &key, size_t hash, _Args &&...args) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    if (_find_slot(sh, key, hash) != NPOS) {
+      return false;
+    }
+    return _insert_slot(sh, hash, std::forward<_Args>(args)...) != NPOS;
+  }
+
+  /// one locked pass of compute(): fn creates, changes or removes the value
+  template <typename _K, typename _F>
+  LockedHashOutcome _compute(const _K &key, size_t hash, _F &fn) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx == NPOS) {
+      tl::optional<_Tp> tp = LockedHashEntry<_Tp>::create(fn);
+      if (!tp.has_value()) {
+        return LockedHashOutcome::absent;
+      }
+      if (_insert_slot(sh, hash, std::move(*tp)) == NPOS) {
+        return LockedHashOutcome::full;
+      }
+      return LockedHashOutcome::inserted;
+    }
+    LockedHashSlot &slot = sh.slots[idx];
+    if (LockedHashEntry<_Tp>::update(fn, slot._tp)) {
+      _erase_slot(sh, idx);
+      return LockedHashOutcome::removed;
+    }
+    slot._timestamp = time(nullptr);
+    return LockedHashOutcome::updated;
+  }
+
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _rm(const _K &key, size_t hash, _F &rmf) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx == NPOS) {
+      return tl::nullopt;
+    }
+    if (LockedHashCallback::set(rmf) && !rmf(sh.slots[idx]._tp)) {
+      return tl::nullopt;
+    }
+    tl::optional<_Tp> opt(std::move(sh.slots[idx]._tp));
+    _erase_slot(sh, idx);
+    return opt;
+  }
+
+  template <typename _K, typename _F>
+  void _find(const _K &key, size_t hash, _F &findf) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx != NPOS) {
+      findf(sh.slots[idx]._tp);
+    }
+  }
+
+  /// shard locks are exclusive; same as _find
+  template <typename _K, typename _F>
+  void _find_shared(const _K &key, size_t hash, _F &findf) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx != NPOS) {
+      findf(sh.slots[idx]._tp);
+    }
+  }
+
+  template <typename _K> accessor _access(const _K &key, size_t hash) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    return accessor(std::move(guard),
+                    idx != NPOS ? &sh.slots[idx]._tp : nullptr);
+  }
+
+  template <typename _K>
+  const_accessor _access_shared(const _K &key, size_t hash) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    return const_accessor(std::move(guard),
+                          idx != NPOS ? &sh.slots[idx]._tp : nullptr);
+  }
+
+  template <typename _K>
+  tl::optional<_Tp> _alive(const _K &key, size_t hash) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx == NPOS) {
+      return tl::nullopt;
+    }
+    sh.slots[idx]._timestamp = time(nullptr);
+    return tl::make_optional<_Tp>(sh.slots[idx]._tp);
+  }
+
+  static size_t _shards_for(size_t bucket_size, size_t lock_stripes) {
+    if (lock_stripes) {
+      return lock_stripes;
+    }
+    size_t shard_slots = LOCKEDHASH_CUCKOO_SHARD_SLOTS;
+    return (bucket_size + shard_slots - 1) / shard_slots;
+  }
+
+public:
+  /**
+   * @brief Construct a new LockedHash object
+   *
+   * @param bucket_size   expected elements; sets the number of shards
+   *                      (bucket_size / LOCKEDHASH_CUCKOO_SHARD_SLOTS, 2^n)
+   *                      and their initial slots
+   * @param expire_time   expire time (0: never expire)
+   * @param lock_stripes  number of shards (locks), rounded up to 2^n
+   *                      (0: from bucket_size)
+   * @param alloc         slot array allocator
+   */
+  LockedHash(size_t bucket_size, time_t expire_time = 0,
+             size_t lock_stripes = 0, const _Alloc &alloc = _Alloc())
+      : _alloc(alloc), _shards(_shards_for(bucket_size, lock_stripes)) {
+    _shard_count = _shards.size();
+    _shard_bits = 0;
+    while ((1UL << _shard_bits) < _shard_count) {
+      _shard_bits++;
+    }
+    size_t per_shard = (bucket_size + _shard_count - 1) / _shard_count;
+    _shard_buckets = 1;
+    while (_shard_buckets * LOCKEDHASH_CUCKOO_WAYS < per_shard) {
+      _shard_buckets <<= 1;
+    }
+    _expire_time = expire_time;
+  }
+
+  /**
+   * @brief Destroy the Locked Hash object
+   *
+   */
+  virtual ~LockedHash() {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.tags[i]) {
+          sh.slots[i].~LockedHashSlot();
+        }
+      }
+      _free(sh.tags, sh.slots, _capacity(sh));
+    }
+  }
+
+  /**
+   * @brief total element size
+   *
+   * @return size_t
+   */
+  size_t size() { //
+    return _size.load();
+  }
+
+  /**
+   * @brief total element size, without reading the counters of the other
+   * threads (LockedHashCounter::load_relaxed)
+   *
+   * @return size_t
+   */
+  size_t size_relaxed() { //
+    return _size.load_relaxed();
+  }
+
+  /**
+   * @brief number of shards
+   *
+   * @return size_t
+   */
+  size_t bucket_count() { //
+    return _shard_count;
+  }
+
+  /**
+   * @brief number of shard locks (= bucket_count())
+   *
+   * @return size_t
+   */
+  size_t lock_stripes() { //
+    return _shard_count;
+  }
+
+  /**
+   * @brief total slots allocated
+   *
+   * @return size_t
+   */
+  size_t capacity() {
+    size_t tot = 0;
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashGuard guard(_shards[s]);
+      tot += _capacity(_shards[s]);
+    }
+    return tot;
+  }
+
+  /**
+   * @brief occupancy: size() / capacity()
+   *
+   * @return double
+   */
+  double load_factor() {
+    size_t cap = capacity();
+    return cap ? (double)size() / cap : 0;
+  }
+
+  /**
+   * @brief element number of each shard
+   *
+   * @return std::vector<size_t>
+   */
+  std::vector<size_t> bucket_elements() {
+    std::vector<size_t> v;
+
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashGuard guard(_shards[s]);
+      v.push_back(_shards[s].elements);
+    }
+    return v;
+  }
+
+  void clear() {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.tags[i]) {
+          sh.slots[i].~LockedHashSlot();
+          sh.tags[i] = 0;
+          _size.add(-1);
+        }
+      }
+      sh.elements = 0;
+    }
+  }
+
+private:
+  /**
+   * @brief core of loop()
+   * loopf 결과가 true인 경우 Node의 timestamp를 업데이트 한다.
+   *
+   * @param loopf
+   */
+  template <typename _F> void _loop(_F &loopf) {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.tags[i] == 0) {
+          continue;
+        }
+        LockedHashSlot &slot = sh.slots[i];
+        if (loopf(s, slot._timestamp, slot._tp)) {
+          slot._timestamp = time(nullptr);
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief core of loop_shared()
+   * shard locks are exclusive; loop without the timestamp update.
+   *
+   * @param loopf
+   */
+  template <typename _F> void _loop_shared(_F &loopf) {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.tags[i]) {
+          loopf(s, sh.slots[i]._timestamp, sh.slots[i]._tp);
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief core of loop_with_delete()
+   * loopf 결과가 true인 경우 Node를 제거한다.
+   *
+   * @param loopf
+   */
+  template <typename _F> void _loop_with_delete(_F &loopf) {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.tags[i] == 0) {
+          continue;
+        }
+        LockedHashSlot &slot = sh.slots[i];
+        if (loopf(s, slot._timestamp, slot._tp)) {
+          _erase_slot(sh, i);
+        }
+      }
+    }
+  }
+
+  tl::optional<std::list<_Tp>> _expire() {
+    if (_expire_time == 0) {
+      return tl::nullopt;
+    }
+    time_t now = time(nullptr);
+    time_t expire_time = _expire_time;
+    auto expiref = [now, expire_time](_Tp &, time_t timestamp, void *) {
+      return now - timestamp > expire_time;
+    };
+    return _expire(expiref, nullptr);
+  }
+
+  template <typename _F>
+  tl::optional<std::list<_Tp>> _expire(_F &expiref, void *arg) {
+    std::list<_Tp> expired;
+
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.tags[i] == 0) {
+          continue;
+        }
+        LockedHashSlot &slot = sh.slots[i];
+        if (expiref(slot._tp, slot._timestamp, arg)) {
+          expired.push_back(std::move(slot._tp));
+          _erase_slot(sh, i);
+        }
+      }
+    }
+
+    return expired.empty() ? tl::nullopt
+                           : tl::make_optional(std::move(expired));
+  }
+
+  template <typename _F> void _showdata(_F &showdataf) {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      if (sh.elements == 0) {
+        continue;
+      }
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.tags[i]) {
+          showdataf(s, sh.slots[i]._tp);
+        }
+      }
+    }
+  }
+
+  template <typename _F> void _showbucket(_F &showdataf) {
+    for (size_t s = 0; s < _shard_count; s++) {
+      size_t cnt;
+      {
+        LockedHashGuard guard(_shards[s]);
+        cnt = _shards[s].elements;
+      }
+      showdataf(s, cnt);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef __LOCKED_HASH_EPOCH_HPP__
+#define __LOCKED_HASH_EPOCH_HPP__
+
+#include <atomic>
+#include <lockedhash_lock.hpp>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/// epoch slots allocated at once; more are added as threads need them
+#define LOCKEDHASH_EPOCH_THREADS 256
+/// retired nodes of a stripe before a reclaim is tried
+#define LOCKEDHASH_EPOCH_RECLAIM 64
+
+/**
+ * @brief LockedHashEpoch
+ * epoch-based reclamation shared by every LockedHash of the process.
+ *
+ * A lock-free reader enters the epoch before loading the first pointer and
+ * exits after the last use. A writer unlinks a node, then retires it with
+ * the current epoch; the node is freed once every reader inside an epoch
+ * has entered after that epoch (reclaimable()).
+ *
+ * Each thread owns one cache-line slot, so entering and exiting only
+ * writes to the thread's own line. A thread keeps its slot until it exits;
+ * when every slot is owned, another block of LOCKEDHASH_EPOCH_THREADS
+ * slots is added, so entering never waits. Blocks are never freed: a
+ * thread may still own a slot at process exit.
+ *
+ */
+class LockedHashEpoch {
+private:
+  struct alignas(LOCKEDHASH_CACHELINE) Slot {
+    /// epoch the owner entered at (0: not inside)
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> used{false};
+  };
+
+  struct Block {
+    Slot slots[LOCKEDHASH_EPOCH_THREADS];
+    /// next block (added before this one)
+    std::atomic<Block *> next{nullptr};
+  };
+
+  struct ThreadSlot {
+    Slot *slot = nullptr;
+    size_t depth = 0;
+    ~ThreadSlot() {
+      if (slot) {
+        slot->used.store(false);
+      }
+    }
+  };
+
+  std::atomic<uint64_t> _global{1};
+  /// first block; the added ones follow it, newest first
+  Block _first;
+
+  static ThreadSlot &_thread() {
+    static thread_local ThreadSlot ts;
+    return ts;
+  }
+
+  Slot *_claim() {
+    for (Block *b = &_first; b; b = b->next.load()) {
+      for (size_t i = 0; i < LOCKEDHASH_EPOCH_THREADS; i++) {
+        bool expected = false;
+        if (!b->slots[i].used.load(std::memory_order_relaxed) &&
+            b->slots[i].used.compare_exchange_strong(expected, true)) {
+          return &b->slots[i];
+        }
+      }
+    }
+    // every slot is owned: add a block, its first slot for this thread
+    void *mem = nullptr;
+    // new Block does not honour alignas before C++17
+    if (posix_memalign(&mem, alignof(Block), sizeof(Block))) {
+      throw std::bad_alloc();
+    }
+    Block *b = new (mem) Block();
+    b->slots[0].used.store(true, std::memory_order_relaxed);
+    Block *next = _first.next.load();
+    do {
+      b->next.store(next, std::memory_order_relaxed);
+    } while (!_first.next.compare_exchange_weak(next, b));
+    return &b->slots[0];
+  }
+
+public:
+  static LockedHashEpoch &instance() {
+    static LockedHashEpoch epoch;
+    return epoch;
+  }
+
+  /**
+   * @brief enter the epoch (nested calls only count)
+   *
+   */
+  void enter() {
+    ThreadSlot &ts = _thread();
+    if (ts.depth > 0) {
+      ts.depth++;
+      return;
+    }
+    if (ts.slot == nullptr) {
+      ts.slot = _claim();
+    }
+    ts.slot->epoch.store(_global.load(), std::memory_order_relaxed);
+    // the pointers loaded next must not be read before the store is seen
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    ts.depth = 1;
+  }
+
+  void exit() {
+    ThreadSlot &ts = _thread();
+    if (--ts.depth == 0) {
+      ts.slot->epoch.store(0, std::memory_order_release);
+    }
+  }
+
+  /// epoch of a node retired now (read after the node is unlinked)
+  uint64_t current() { //
+    return _global.load();
+  }
+
+  /**
+   * @brief advance the epoch
+   *
+   * @return uint64_t nodes retired before this epoch can be freed
+   */
+  uint64_t reclaimable() {
+    uint64_t min = _global.fetch_add(1) + 1;
+    for (Block *b = &_first; b; b = b->next.load()) {
+      for (size_t i = 0; i < LOCKEDHASH_EPOCH_THREADS; i++) {
+        uint64_t e = b->slots[i].epoch.load();
+        if (e != 0 && e < min) {
+          min = e;
+        }
+      }
+    }
+    return min;
+  }
+};
+
+/**
+ * @brief scope of a lock-free read
+ *
+ */
+class LockedHashEpochGuard {
+public:
+  LockedHashEpochGuard() { //
+    LockedHashEpoch::instance().enter();
+  }
+  ~LockedHashEpochGuard() { //
+    LockedHashEpoch::instance().exit();
+  }
+};
+
+#endif
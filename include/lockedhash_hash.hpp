@@ -0,0 +1,358 @@
+#ifndef __LOCKED_HASH_HASH_HPP__
+#define __LOCKED_HASH_HASH_HPP__
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief built-in key hash functions
+ *
+ * Usable as _Hash / _KeyHash. Besides operator() they hash an array of
+ * keys at once, batch(keys, n, out); the multi_*() calls of LockedHash
+ * hash their keys through it. With AVX2 (-mavx2) 4 keys go through one
+ * instruction stream, otherwise batch() is a scalar loop. Both give the
+ * same hashes.
+ *
+ * LockedHashStringHash and LockedHashTupleHash cover strings, pairs and
+ * tuples; LockedHashMixed<_Hash> finalizes the output of a user hash.
+ *
+ */
+
+/**
+ * @brief murmur3 64-bit finalizer, on one hash or on 4 (AVX2)
+ *
+ */
+class LockedHashFmix {
+public:
+  static const uint64_t C1 = 0xff51afd7ed558ccdULL;
+  static const uint64_t C2 = 0xc4ceb9fe1a85ec53ULL;
+  /// multiplier of the word steps (LockedHashBytesHash)
+  static const uint64_t K = 0x9e3779b97f4a7c15ULL;
+
+  static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= C1;
+    h ^= h >> 33;
+    h *= C2;
+    h ^= h >> 33;
+    return h;
+  }
+
+  /// fold word w into h
+  static uint64_t step(uint64_t h, uint64_t w) {
+    h = (h ^ w) * K;
+    return h ^ (h >> 32);
+  }
+
+  /// hash_combine: hash of the sequence (..., h), seed the hash of (...)
+  static uint64_t combine(uint64_t seed, uint64_t h) {
+    return mix(seed * K ^ h);
+  }
+
+#ifdef __AVX2__
+  /// a * b (low 64 bits) of each lane: AVX2 multiplies 32 x 32 bits only
+  static __m256i mul(__m256i a, __m256i b) {
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i cross =
+        _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                         _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+  }
+
+  static __m256i mix(__m256i h) {
+    h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+    h = mul(h, _mm256_set1_epi64x((long long)C1));
+    h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+    h = mul(h, _mm256_set1_epi64x((long long)C2));
+    return _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+  }
+
+  static __m256i step(__m256i h, __m256i w) {
+    h = mul(_mm256_xor_si256(h, w), _mm256_set1_epi64x((long long)K));
+    return _mm256_xor_si256(h, _mm256_srli_epi64(h, 32));
+  }
+#endif
+};
+
+/**
+ * @brief hash of integral keys: the murmur3 finalizer of the key (as a
+ * 64-bit integer, sign extended)
+ *
+ */
+struct LockedHashIntHash {
+  template <typename _I, typename = typename std::enable_if<
+                             std::is_integral<_I>::value>::type>
+  size_t operator()(_I key) const noexcept {
+    return LockedHashFmix::mix((uint64_t)key);
+  }
+
+  /// out[i] = operator()(keys[i]) for i < n
+  template <typename _I, typename = typename std::enable_if<
+                             std::is_integral<_I>::value>::type>
+  void batch(const _I *keys, size_t n, size_t *out) const noexcept {
+    size_t i = 0;
+#ifdef __AVX2__
+    if (sizeof(_I) == 8 || sizeof(_I) == 4) {
+      for (; n - i >= 4; i += 4) {
+        _mm256_storeu_si256((__m256i *)(out + i),
+                            LockedHashFmix::mix(_load4(keys + i)));
+      }
+    }
+#endif
+    for (size_t j = 0; j < n - i; j++) {
+      out[i + j] = operator()(keys[i + j]);
+    }
+  }
+
+private:
+#ifdef __AVX2__
+  /// 4 keys of 8 or 4 bytes as 64-bit lanes
+  template <typename _I> static __m256i _load4(const _I *keys) {
+    if (sizeof(_I) == 8) {
+      return _mm256_loadu_si256((const __m256i *)keys);
+    }
+    __m128i k = _mm_loadu_si128((const __m128i *)keys);
+    return std::is_signed<_I>::value ? _mm256_cvtepi32_epi64(k)
+                                     : _mm256_cvtepu32_epi64(k);
+  }
+#endif
+};
+
+/**
+ * @brief hash of fixed-width keys (a struct of integers, an address, ...):
+ * the bytes of the key, 8 at a time. the key must be trivially copyable
+ * and have no padding bytes (their value is undefined).
+ *
+ */
+struct LockedHashBytesHash {
+  template <typename _K> size_t operator()(const _K &key) const noexcept {
+    static_assert(std::is_trivially_copyable<_K>::value,
+                  "LockedHashBytesHash hashes the bytes of the key");
+    uint64_t h = sizeof(_K);
+    for (size_t off = 0; off < sizeof(_K); off += 8) {
+      h = LockedHashFmix::step(h, _word(&key, off));
+    }
+    return LockedHashFmix::mix(h);
+  }
+
+  /// out[i] = operator()(keys[i]) for i < n
+  template <typename _K>
+  void batch(const _K *keys, size_t n, size_t *out) const noexcept {
+    size_t i = 0;
+#ifdef __AVX2__
+    for (; n - i >= 4; i += 4) {
+      __m256i h = _mm256_set1_epi64x(sizeof(_K));
+      for (size_t off = 0; off < sizeof(_K); off += 8) {
+        __m256i w = _mm256_set_epi64x(
+            (long long)_word(&keys[i + 3], off),
+            (long long)_word(&keys[i + 2], off),
+            (long long)_word(&keys[i + 1], off),
+            (long long)_word(&keys[i], off));
+        h = LockedHashFmix::step(h, w);
+      }
+      _mm256_storeu_si256((__m256i *)(out + i), LockedHashFmix::mix(h));
+    }
+#endif
+    for (size_t j = 0; j < n - i; j++) {
+      out[i + j] = operator()(keys[i + j]);
+    }
+  }
+
+private:
+  /// 8 bytes of key from off, zero padded past its end
+  template <typename _K> static uint64_t _word(const _K *key, size_t off) {
+    uint64_t w = 0;
+    memcpy(&w, (const char *)key + off,
+           sizeof(_K) - off < 8 ? sizeof(_K) - off : 8);
+    return w;
+  }
+};
+
+/**
+ * @brief wyhash-style hash of a byte range: 16 bytes per 64 x 64 -> 128-bit
+ * multiply, its halves xored (mum)
+ *
+ */
+class LockedHashWyhash {
+public:
+  static const uint64_t P0 = 0xa0761d6478bd642fULL;
+  static const uint64_t P1 = 0xe7037ed1a0b428dbULL;
+  static const uint64_t P2 = 0x8ebc6af09c88c6e3ULL;
+  static const uint64_t P3 = 0x589965cc75374cc3ULL;
+
+  static uint64_t mum(uint64_t a, uint64_t b) {
+    unsigned __int128 r = (unsigned __int128)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+  }
+
+  static uint64_t hash(const void *key, size_t len, uint64_t seed = 0) {
+    const uint8_t *p = (const uint8_t *)key;
+    seed ^= mum(seed ^ P0, P1);
+    uint64_t a = 0, b = 0;
+    if (len <= 16) {
+      if (len >= 4) {
+        // 2 to 4 overlapping 4-byte reads cover the range
+        size_t mid = (len >> 3) << 2;
+        a = (_r4(p) << 32) | _r4(p + mid);
+        b = (_r4(p + len - 4) << 32) | _r4(p + len - 4 - mid);
+      } else if (len > 0) {
+        a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) |
+            p[len - 1];
+      }
+    } else {
+      size_t i = len;
+      if (i > 48) {
+        // 3 independent lanes
+        uint64_t s1 = seed, s2 = seed;
+        do {
+          seed = mum(_r8(p) ^ P1, _r8(p + 8) ^ seed);
+          s1 = mum(_r8(p + 16) ^ P2, _r8(p + 24) ^ s1);
+          s2 = mum(_r8(p + 32) ^ P3, _r8(p + 40) ^ s2);
+          p += 48;
+          i -= 48;
+        } while (i > 48);
+        seed ^= s1 ^ s2;
+      }
+      while (i > 16) {
+        seed = mum(_r8(p) ^ P1, _r8(p + 8) ^ seed);
+        p += 16;
+        i -= 16;
+      }
+      // the last 16 bytes, overlapping what was folded already
+      a = _r8(p + i - 16);
+      b = _r8(p + i - 8);
+    }
+    unsigned __int128 r = (unsigned __int128)(a ^ P1) * (b ^ seed);
+    return mum((uint64_t)r ^ P0 ^ len, (uint64_t)(r >> 64) ^ P1);
+  }
+
+private:
+  static uint64_t _r8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+  }
+
+  static uint64_t _r4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+  }
+};
+
+/**
+ * @brief hash of strings (LockedHashWyhash of the characters); transparent,
+ * so a const char * is hashed without building a std::string
+ *
+ */
+struct LockedHashStringHash {
+  typedef void is_transparent;
+
+  size_t operator()(const std::string &s) const noexcept {
+    return LockedHashWyhash::hash(s.data(), s.size());
+  }
+
+  size_t operator()(const char *s) const noexcept {
+    return LockedHashWyhash::hash(s, strlen(s));
+  }
+};
+
+/**
+ * @brief hash of std::pair and std::tuple: the hashes of the elements,
+ * combined in order (LockedHashFmix::combine). an element is hashed by
+ * LockedHashIntHash (integral), LockedHashStringHash (std::string),
+ * LockedHashTupleHash (pair, tuple), or else std::hash, finalized.
+ * ex) LockedHash<std::pair<std::string, int>, Person, LockedHashTupleHash,
+ *                PersonMakeKey>
+ *
+ */
+struct LockedHashTupleHash {
+  template <typename _A, typename _B>
+  size_t operator()(const std::pair<_A, _B> &p) const noexcept {
+    return LockedHashFmix::combine(_element(p.first), _element(p.second));
+  }
+
+  template <typename... _Ts>
+  size_t operator()(const std::tuple<_Ts...> &t) const noexcept {
+    return _tuple(t, std::integral_constant<size_t, 0>(), 0);
+  }
+
+private:
+  template <typename _T, size_t _I>
+  static size_t _tuple(const _T &t, std::integral_constant<size_t, _I>,
+                       uint64_t seed) {
+    return _tuple(t, std::integral_constant<size_t, _I + 1>(),
+                  LockedHashFmix::combine(seed, _element(std::get<_I>(t))));
+  }
+
+  template <typename... _Ts>
+  static size_t _tuple(const std::tuple<_Ts...> &,
+                       std::integral_constant<size_t, sizeof...(_Ts)>,
+                       uint64_t seed) {
+    return seed;
+  }
+
+  static size_t _element(const std::string &s) {
+    return LockedHashStringHash()(s);
+  }
+
+  template <typename _A, typename _B>
+  static size_t _element(const std::pair<_A, _B> &p) {
+    return LockedHashTupleHash()(p);
+  }
+
+  template <typename... _Ts>
+  static size_t _element(const std::tuple<_Ts...> &t) {
+    return LockedHashTupleHash()(t);
+  }
+
+  template <typename _T> static size_t _element(const _T &v) {
+    return _scalar(v, std::is_integral<_T>());
+  }
+
+  template <typename _T> static size_t _scalar(const _T &v, std::true_type) {
+    return LockedHashIntHash()(v);
+  }
+
+  template <typename _T> static size_t _scalar(const _T &v, std::false_type) {
+    return LockedHashFmix::mix(std::hash<_T>()(v));
+  }
+};
+
+/**
+ * @brief the murmur3 finalizer on the output of _Hash
+ * a weak user hash (identity, a sum of fields, std::hash of an integer)
+ * piles keys into few buckets, and so onto few bucket locks; finalized,
+ * every bit of the hash depends on every bit of the key.
+ * ex) LockedHash<PersonKey, Person, LockedHashMixed<PersonHash>, ...>
+ *
+ * _Hash keeps its is_transparent; its batch(), if any, is finalized too.
+ *
+ * @tparam _Hash
+ */
+template <typename _Hash> struct LockedHashMixed : _Hash {
+  template <typename _K> size_t operator()(const _K &key) const {
+    return LockedHashFmix::mix(_Hash::operator()(key));
+  }
+
+  /// only if _Hash has one (_H: _Hash, deduced late for SFINAE)
+  template <typename _K, typename _H = _Hash>
+  auto batch(const _K *keys, size_t n, size_t *out) const
+      -> decltype(std::declval<const _H &>().batch(keys, n, out)) {
+    _H::batch(keys, n, out);
+    for (size_t i = 0; i < n; i++) {
+      out[i] = LockedHashFmix::mix(out[i]);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef __LOCKED_HASH_INDEX_HPP__
+#define __LOCKED_HASH_INDEX_HPP__
+
+#include <lockedhash_hash.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief bucket index policies of LockedHashChained
+ *
+ * An index policy splits a hash into
+ *  - home: initial bucket (and bucket lock), 0 <= home < bucket_size
+ *  - high: bits above home; linear hashing takes its low bits for the
+ *          buckets added by each doubling
+ *
+ * init(n) is called once with the requested bucket size and returns the
+ * bucket size actually used.
+ *
+ */
+
+/**
+ * @brief hash % bucket_size (one 64-bit division)
+ *
+ */
+class LockedHashIndexModulo {
+private:
+  size_t _n = 1;
+
+public:
+  size_t init(size_t n) { //
+    return _n = n;
+  }
+
+  void operator()(size_t hash, size_t &home, size_t &high) const {
+    home = hash % _n;
+    high = hash / _n;
+  }
+};
+
+/**
+ * @brief hash & (bucket_size - 1), bucket_size rounded up to 2^n
+ * the hash goes through the murmur3 finalizer (LockedHashFmix) first, so
+ * that weak hashes (identity, sums of fields) still spread over the low
+ * bits.
+ *
+ */
+class LockedHashIndexMask {
+private:
+  size_t _mask = 0;
+  size_t _shift = 0;
+
+public:
+  size_t init(size_t n) {
+    _shift = 0;
+    while ((1UL << _shift) < n) {
+      _shift++;
+    }
+    _mask = (1UL << _shift) - 1;
+    return _mask + 1;
+  }
+
+  void operator()(size_t hash, size_t &home, size_t &high) const {
+    hash = LockedHashFmix::mix(hash);
+    home = hash & _mask;
+    high = hash >> _shift;
+  }
+};
+
+/**
+ * @brief Lemire fastrange: (hash * bucket_size) >> 64
+ * home comes from the high bits of the hash and high from its low bits;
+ * needs a hash whose high bits are well mixed (not an identity hash).
+ *
+ */
+class LockedHashIndexFastrange {
+private:
+  size_t _n = 1;
+
+public:
+  size_t init(size_t n) { //
+    return _n = n;
+  }
+
+  void operator()(size_t hash, size_t &home, size_t &high) const {
+    home = (size_t)(((unsigned __int128)hash * _n) >> 64);
+    high = hash;
+  }
+};
+
+/**
+ * @brief hash % bucket_size by a precomputed reciprocal
+ * same buckets as LockedHashIndexModulo for any bucket size, with a
+ * multiply instead of a division.
+ *
+ */
+class LockedHashIndexReciprocal {
+private:
+  size_t _n = 1;
+  /// floor((2^64 - 1) / n)
+  uint64_t _m = UINT64_MAX;
+
+public:
+  size_t init(size_t n) {
+    _n = n;
+    _m = UINT64_MAX / n;
+    return n;
+  }
+
+  void operator()(size_t hash, size_t &home, size_t &high) const {
+    // q is floor(hash / n) or one less
+    uint64_t q = (uint64_t)(((unsigned __int128)hash * _m) >> 64);
+    uint64_t r = hash - q * _n;
+    if (r >= _n) {
+      r -= _n;
+      q++;
+    }
+    home = r;
+    high = q;
+  }
+};
+
+#endif
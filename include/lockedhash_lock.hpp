@@ -0,0 +1,407 @@
+#ifndef __LOCKED_HASH_LOCK_HPP__
+#define __LOCKED_HASH_LOCK_HPP__
+
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+/// cache line size
+#define LOCKEDHASH_CACHELINE 64
+/// default maximum lock stripes of a LockedHash (bucket_size if smaller)
+#define LOCKEDHASH_LOCK_STRIPES 1024
+/// optimistic reads tried before a reader takes the lock (LockedHashSeqLock)
+#define LOCKEDHASH_SEQLOCK_RETRIES 16
+
+/// cells of a LockedHashCounter (threads are spread over them)
+#define LOCKEDHASH_COUNTER_CELLS 64
+/// count a cell keeps before it folds it into the shared total
+#define LOCKEDHASH_COUNTER_BATCH 32
+
+/// racy by design (validated afterwards): keep ThreadSanitizer out
+#if defined(__GNUC__) || defined(__clang__)
+#define LOCKEDHASH_NO_SANITIZE_THREAD __attribute__((no_sanitize_thread))
+#else
+#define LOCKEDHASH_NO_SANITIZE_THREAD
+#endif
+
+/// fetch the cache line of p ahead of its use (never faults)
+#if defined(__GNUC__) || defined(__clang__)
+#define LOCKEDHASH_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define LOCKEDHASH_PREFETCH(p) ((void)(p))
+#endif
+
+/**
+ * @brief lock policy: recursive mutex; reads are exclusive too (default)
+ *
+ */
+class LockedHashRecursiveLock {
+private:
+  std::recursive_mutex _m;
+
+public:
+  /// reads run without the lock (LockedHashSeqLock)
+  static const bool optimistic = false;
+  /// reads run without the lock, in an epoch (LockedHashEpochLock)
+  static const bool epoch = false;
+
+  void lock() { //
+    _m.lock();
+  }
+  void unlock() { //
+    _m.unlock();
+  }
+  void lock_shared() { //
+    _m.lock();
+  }
+  void unlock_shared() { //
+    _m.unlock();
+  }
+};
+
+/**
+ * @brief lock policy: reader/writer lock
+ * reads (search, find_shared, loop_shared, showdata, ...) of a stripe run
+ * in parallel; writes are exclusive.
+ *
+ * Both modes are recursive for the owning thread, as callbacks may call
+ * back into the table: a read or a write under a write, and a read under
+ * a read. A write under a read of the same stripe would deadlock and is
+ * not allowed (callbacks of shared reads must not modify the table).
+ *
+ */
+class LockedHashSharedLock {
+private:
+  std::shared_timed_mutex _m;
+  /// exclusive owner, and its recursion depth
+  std::atomic<std::thread::id> _owner{std::thread::id()};
+  size_t _depth = 0;
+
+  /// shared locks held by this thread, with their recursion depth
+public:
+  static const bool optimistic = false;
+  static const bool epoch = false;
+
+private:
+  static std::vector<std::pair<LockedHashSharedLock *, size_t>> &_held() {
+    static thread_local std::vector<std::pair<LockedHashSharedLock *, size_t>>
+        held;
+    return held;
+  }
+
+  size_t *_held_depth() {
+    for (auto &h : _held()) {
+      if (h.first == this) {
+        return &h.second;
+      }
+    }
+    return nullptr;
+  }
+
+public:
+  void lock() {
+    if (_owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+      _depth++;
+      return;
+    }
+    assert(_held_depth() == nullptr && "write under a shared read");
+    _m.lock();
+    _owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    _depth = 1;
+  }
+
+  void unlock() {
+    if (--_depth == 0) {
+      _owner.store(std::thread::id(), std::memory_order_relaxed);
+      _m.unlock();
+    }
+  }
+
+  void lock_shared() {
+    if (_owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+      // read under our own write
+      _depth++;
+      return;
+    }
+    size_t *depth = _held_depth();
+    if (depth) {
+      (*depth)++;
+      return;
+    }
+    _m.lock_shared();
+    _held().push_back(std::make_pair(this, 1));
+  }
+
+  void unlock_shared() {
+    if (_owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+      unlock();
+      return;
+    }
+    auto &held = _held();
+    for (size_t i = held.size(); i > 0; i--) {
+      if (held[i - 1].first != this) {
+        continue;
+      }
+      if (--held[i - 1].second == 0) {
+        held.erase(held.begin() + (i - 1));
+        _m.unlock_shared();
+      }
+      return;
+    }
+  }
+};
+
+/**
+ * @brief lock policy: recursive mutex with a sequence counter (seqlock)
+ * the counter is odd while a writer holds the lock. searches copy the
+ * value out without locking, and retry if the counter moved meanwhile:
+ *
+ *   size_t seq = lock.read_begin();  // odd: writer inside, retry
+ *   ... copy ...
+ *   if (lock.read_retry(seq)) retry;
+ *
+ * needs a trivially copyable _Tp and a type-stable node allocator
+ * (LockedHashSlabAllocator), so that a racing reader only ever reads node
+ * memory.
+ *
+ */
+class LockedHashSeqLock {
+private:
+  std::recursive_mutex _m;
+  std::atomic<size_t> _seq{0};
+  /// recursion depth of the owner
+  size_t _depth = 0;
+
+public:
+  static const bool optimistic = true;
+  static const bool epoch = false;
+
+  void lock() {
+    _m.lock();
+    if (_depth++ == 0) {
+      _seq.store(_seq.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+  }
+
+  void unlock() {
+    if (--_depth == 0) {
+      _seq.store(_seq.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+    }
+    _m.unlock();
+  }
+
+  void lock_shared() { //
+    lock();
+  }
+
+  void unlock_shared() { //
+    unlock();
+  }
+
+  size_t read_begin() { //
+    return _seq.load(std::memory_order_acquire);
+  }
+
+  /// true if a writer took the lock since read_begin() returned seq
+  bool read_retry(size_t seq) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return (seq & 1) || _seq.load(std::memory_order_relaxed) != seq;
+  }
+};
+
+/**
+ * @brief lock policy: recursive mutex for writers; readers take no lock
+ * searches and find_shared walk the chain with acquire loads inside a
+ * LockedHashEpoch, and removed nodes are freed only after every reader
+ * that could still see them has left. any _Tp.
+ *
+ * values are replaced, not changed in place: an update (interceptor,
+ * find) copies the node, changes the copy and swaps it in. loop and expire
+ * callbacks must not modify tp while lock-free readers run.
+ *
+ */
+class LockedHashEpochLock {
+private:
+  std::recursive_mutex _m;
+
+public:
+  static const bool optimistic = false;
+  static const bool epoch = true;
+
+  void lock() { //
+    _m.lock();
+  }
+  void unlock() { //
+    _m.unlock();
+  }
+  void lock_shared() { //
+    _m.lock();
+  }
+  void unlock_shared() { //
+    _m.unlock();
+  }
+};
+
+/**
+ * @brief loads of the optimistic read path
+ * a writer may change the memory meanwhile; the reader validates what it
+ * read (LockedHashSeqLock::read_retry) before using it.
+ *
+ */
+class LockedHashRacy {
+public:
+  template <typename _T>
+  LOCKEDHASH_NO_SANITIZE_THREAD static _T load(const _T &v) {
+    return __atomic_load_n(&v, __ATOMIC_RELAXED);
+  }
+
+  LOCKEDHASH_NO_SANITIZE_THREAD static void copy(void *dst, const void *src,
+                                                 size_t n) {
+    typedef uint64_t __attribute__((__may_alias__)) word;
+    char *d = static_cast<char *>(dst);
+    const char *s = static_cast<const char *>(src);
+    size_t i = 0;
+    if ((((uintptr_t)d | (uintptr_t)s) & (sizeof(word) - 1)) == 0) {
+      for (; i + sizeof(word) <= n; i += sizeof(word)) {
+        *(word *)(d + i) = __atomic_load_n((const word *)(s + i),
+                                           __ATOMIC_RELAXED);
+      }
+    }
+    for (; i < n; i++) {
+      d[i] = __atomic_load_n(s + i, __ATOMIC_RELAXED);
+    }
+  }
+};
+
+/**
+ * @brief LockedHashCounter
+ * element counter of a LockedHash that does not bounce one cache line
+ * between all writers. each thread adds to its own padded cell, and a cell
+ * folds its count into the shared total once it reaches
+ * +-LOCKEDHASH_COUNTER_BATCH.
+ *
+ *  - load(): total and every cell; exact once the writers are done
+ *  - load_relaxed(): total and the cell of this thread; off by less than
+ *    LOCKEDHASH_COUNTER_BATCH per other writing thread
+ *
+ */
+class LockedHashCounter {
+private:
+  struct alignas(LOCKEDHASH_CACHELINE) Cell {
+    std::atomic<ptrdiff_t> n{0};
+  };
+
+  Cell _total;
+  Cell _cells[LOCKEDHASH_COUNTER_CELLS];
+
+  static size_t _thread_index() {
+    static std::atomic<size_t> threads{0};
+    static thread_local size_t index = threads++;
+    return index % LOCKEDHASH_COUNTER_CELLS;
+  }
+
+  static size_t _clamp(ptrdiff_t n) { //
+    return n < 0 ? 0 : (size_t)n;
+  }
+
+public:
+  void add(ptrdiff_t d) {
+    Cell &c = _cells[_thread_index()];
+    ptrdiff_t n = c.n.fetch_add(d, std::memory_order_relaxed) + d;
+    if (n >= LOCKEDHASH_COUNTER_BATCH || n <= -LOCKEDHASH_COUNTER_BATCH) {
+      c.n.fetch_sub(n, std::memory_order_relaxed);
+      _total.n.fetch_add(n, std::memory_order_relaxed);
+    }
+  }
+
+  size_t load() {
+    ptrdiff_t n = _total.n.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < LOCKEDHASH_COUNTER_CELLS; i++) {
+      n += _cells[i].n.load(std::memory_order_relaxed);
+    }
+    return _clamp(n);
+  }
+
+  size_t load_relaxed() {
+    return _clamp(_total.n.load(std::memory_order_relaxed) +
+                  _cells[_thread_index()].n.load(std::memory_order_relaxed));
+  }
+};
+
+/**
+ * @brief LockedHashStripes
+ * array of locks, one per cache line, so that threads taking neighbouring
+ * stripes do not false-share. _Lock may be a struct holding the lock and
+ * the data it guards, to share its line.
+ *
+ * @tparam _Lock
+ */
+template <typename _Lock> class LockedHashStripes {
+private:
+  struct alignas(LOCKEDHASH_CACHELINE) Stripe {
+    _Lock lock;
+  };
+
+  Stripe *_stripes = nullptr;
+  size_t _count = 0;
+  size_t _mask = 0;
+
+public:
+  /**
+   * @brief Construct a new LockedHashStripes object
+   *
+   * @param count  number of stripes, rounded up to 2^n
+   */
+  LockedHashStripes(size_t count) {
+    _count = 1;
+    while (_count < count) {
+      _count <<= 1;
+    }
+    _mask = _count - 1;
+    void *mem = nullptr;
+    // new Stripe[] does not honour alignas before C++17
+    if (posix_memalign(&mem, alignof(Stripe), sizeof(Stripe) * _count)) {
+      throw std::bad_alloc();
+    }
+    _stripes = static_cast<Stripe *>(mem);
+    for (size_t i = 0; i < _count; i++) {
+      new (&_stripes[i]) Stripe();
+    }
+  }
+
+  LockedHashStripes(const LockedHashStripes &) = delete;
+  LockedHashStripes &operator=(const LockedHashStripes &) = delete;
+
+  ~LockedHashStripes() {
+    for (size_t i = 0; i < _count; i++) {
+      _stripes[i].~Stripe();
+    }
+    free(_stripes);
+  }
+
+  /// lock of stripe i (i < size())
+  _Lock &operator[](size_t i) { //
+    return _stripes[i].lock;
+  }
+
+  /// lock of any index (i & (size() - 1))
+  _Lock &of(size_t i) { //
+    return _stripes[i & _mask].lock;
+  }
+
+  size_t size() { //
+    return _count;
+  }
+};
+
+#endif
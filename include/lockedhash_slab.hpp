@@ -0,0 +1,335 @@
+#ifndef __LOCKED_HASH_SLAB_HPP__
+#define __LOCKED_HASH_SLAB_HPP__
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+/// bytes per slab
+#define LOCKEDHASH_SLAB_SIZE (64 * 1024)
+/// objects moved between a magazine and the depot at once
+#define LOCKEDHASH_SLAB_MAGAZINE 64
+/// magazines per pool (threads are spread over them)
+#define LOCKEDHASH_SLAB_MAGAZINES 16
+
+/**
+ * @brief LockedHashSlabPool
+ * fixed size objects carved out of LOCKEDHASH_SLAB_SIZE slabs.
+ *
+ * Threads are spread by thread index over LOCKEDHASH_SLAB_MAGAZINES
+ * magazines (short free lists, each behind its own mutex), and only go to
+ * the shared depot once every LOCKEDHASH_SLAB_MAGAZINE objects. Slabs are
+ * never returned one by one; they are all released when the pool is
+ * destroyed.
+ *
+ */
+class LockedHashSlabPool {
+private:
+  struct Free {
+    Free *next;
+  };
+
+  /// free list of the threads of one index (padded to its own cache lines)
+  struct Magazine {
+    std::mutex lock;
+    Free *head = nullptr;
+    size_t count = 0;
+    char pad[64];
+  };
+
+  size_t _object_size;
+  size_t _objects_per_slab;
+  Magazine _magazines[LOCKEDHASH_SLAB_MAGAZINES];
+
+  /// shared free list and slab list
+  std::mutex _depot_lock;
+  Free *_depot = nullptr;
+  size_t _depot_count = 0;
+  std::vector<void *> _slabs;
+  std::atomic<size_t> _slab_count{0};
+
+  static size_t _thread_index() {
+    static std::atomic<size_t> threads{0};
+    static thread_local size_t index = threads++;
+    return index % LOCKEDHASH_SLAB_MAGAZINES;
+  }
+
+  /// pop up to n objects from the depot (new slab if empty), under lock
+  Free *_depot_get(size_t n, size_t &count) {
+    std::lock_guard<std::mutex> guard(_depot_lock);
+    if (_depot == nullptr) {
+      char *slab = static_cast<char *>(::operator new(LOCKEDHASH_SLAB_SIZE));
+      _slabs.push_back(slab);
+      _slab_count++;
+      for (size_t i = _objects_per_slab; i > 0; i--) {
+        Free *f = reinterpret_cast<Free *>(slab + (i - 1) * _object_size);
+        f->next = _depot;
+        _depot = f;
+      }
+      _depot_count += _objects_per_slab;
+    }
+    Free *head = _depot;
+    Free *tail = head;
+    count = 1;
+    while (count < n && tail->next) {
+      tail = tail->next;
+      count++;
+    }
+    _depot = tail->next;
+    _depot_count -= count;
+    tail->next = nullptr;
+    return head;
+  }
+
+  /// push a chain of count objects to the depot
+  void _depot_put(Free *head, Free *tail, size_t count) {
+    std::lock_guard<std::mutex> guard(_depot_lock);
+    tail->next = _depot;
+    _depot = head;
+    _depot_count += count;
+  }
+
+public:
+  LockedHashSlabPool(size_t object_size) {
+    _object_size = rounded(object_size);
+    _objects_per_slab = LOCKEDHASH_SLAB_SIZE / _object_size;
+  }
+
+  LockedHashSlabPool(const LockedHashSlabPool &) = delete;
+  LockedHashSlabPool &operator=(const LockedHashSlabPool &) = delete;
+
+  /// releases every slab, allocated objects included
+  ~LockedHashSlabPool() {
+    for (void *slab : _slabs) {
+      ::operator delete(slab);
+    }
+  }
+
+  void *allocate() {
+    Magazine &m = _magazines[_thread_index()];
+    std::lock_guard<std::mutex> guard(m.lock);
+    if (m.head == nullptr) {
+      m.head = _depot_get(LOCKEDHASH_SLAB_MAGAZINE, m.count);
+    }
+    Free *f = m.head;
+    m.head = f->next;
+    m.count--;
+    return f;
+  }
+
+  void deallocate(void *p) {
+    Magazine &m = _magazines[_thread_index()];
+    std::lock_guard<std::mutex> guard(m.lock);
+    Free *f = static_cast<Free *>(p);
+    f->next = m.head;
+    m.head = f;
+    if (++m.count < LOCKEDHASH_SLAB_MAGAZINE * 2) {
+      return;
+    }
+    // keep one magazine, return the rest
+    Free *tail = m.head;
+    for (size_t i = 1; i < LOCKEDHASH_SLAB_MAGAZINE; i++) {
+      tail = tail->next;
+    }
+    Free *rest = tail->next;
+    tail->next = nullptr;
+    Free *rest_tail = rest;
+    while (rest_tail->next) {
+      rest_tail = rest_tail->next;
+    }
+    _depot_put(rest, rest_tail, m.count - LOCKEDHASH_SLAB_MAGAZINE);
+    m.count = LOCKEDHASH_SLAB_MAGAZINE;
+  }
+
+  /**
+   * @brief return n objects to the depot with a single lock
+   *
+   * @param ptrs
+   * @param n
+   */
+  void deallocate_bulk(void *const *ptrs, size_t n) {
+    if (n == 0) {
+      return;
+    }
+    Free *head = static_cast<Free *>(ptrs[0]);
+    Free *tail = head;
+    for (size_t i = 1; i < n; i++) {
+      tail->next = static_cast<Free *>(ptrs[i]);
+      tail = tail->next;
+    }
+    _depot_put(head, tail, n);
+  }
+
+  /// object_size rounded up as the pool stores it
+  static size_t rounded(size_t object_size) {
+    size_t align = alignof(max_align_t);
+    if (object_size < sizeof(Free)) {
+      object_size = sizeof(Free);
+    }
+    return (object_size + align - 1) / align * align;
+  }
+
+  size_t object_size() { //
+    return _object_size;
+  }
+
+  /// slabs held by the pool
+  size_t slab_count() { //
+    return _slab_count.load();
+  }
+};
+
+/**
+ * @brief LockedHashSlabPools
+ * the pools of an allocator and of all its rebound copies, one per rounded
+ * object size. A pool is made on the first lookup of its size and lives
+ * as long as the set.
+ */
+class LockedHashSlabPools {
+private:
+  std::mutex _lock;
+  std::vector<std::unique_ptr<LockedHashSlabPool>> _pools;
+
+public:
+  LockedHashSlabPool *get(size_t object_size) {
+    size_t size = LockedHashSlabPool::rounded(object_size);
+    std::lock_guard<std::mutex> guard(_lock);
+    for (auto &pool : _pools) {
+      if (pool->object_size() == size) {
+        return pool.get();
+      }
+    }
+    _pools.emplace_back(new LockedHashSlabPool(size));
+    return _pools.back().get();
+  }
+};
+
+/**
+ * @brief LockedHashSlabAllocator
+ * node allocator for LockedHash (_Alloc). single objects come from a
+ * LockedHashSlabPool; arrays (n > 1) go to ::operator new.
+ *
+ * copies and rebound copies (another _T) share one LockedHashSlabPools,
+ * so A(B(a)) == a and any of them can free what another allocated; a
+ * rebound copy takes the pool of its own object size from the set. The
+ * slabs are released when the last copy goes: a table built from a
+ * default allocator holds the only copy, and frees its nodes with it.
+ *
+ * ex) LockedHash<string, Person, PersonHash, PersonMakeKey,
+ *                LockedHashChained, std::equal_to<string>, PersonHash,
+ *                LockedHashSlabAllocator<Person>>
+ *
+ * @tparam _T
+ */
+template <typename _T> class LockedHashSlabAllocator {
+private:
+  template <typename _U> friend class LockedHashSlabAllocator;
+
+  std::shared_ptr<LockedHashSlabPools> _pools;
+  LockedHashSlabPool *_pool;
+
+public:
+  typedef _T value_type;
+  typedef std::true_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  template <typename _U> struct rebind {
+    typedef LockedHashSlabAllocator<_U> other;
+  };
+
+  LockedHashSlabAllocator()
+      : _pools(std::make_shared<LockedHashSlabPools>()),
+        _pool(_pools->get(sizeof(_T))) {}
+
+  template <typename _U>
+  LockedHashSlabAllocator(const LockedHashSlabAllocator<_U> &o)
+      : _pools(o._pools), _pool(_pools->get(sizeof(_T))) {}
+
+  _T *allocate(size_t n) {
+    static_assert(alignof(_T) <= alignof(max_align_t),
+                  "over-aligned type for LockedHashSlabAllocator");
+    if (n == 1) {
+      return static_cast<_T *>(_pool->allocate());
+    }
+    return static_cast<_T *>(::operator new(n * sizeof(_T)));
+  }
+
+  void deallocate(_T *p, size_t n) {
+    if (n == 1) {
+      _pool->deallocate(p);
+    } else {
+      ::operator delete(p);
+    }
+  }
+
+  /**
+   * @brief free n single objects at once (LockedHash clear)
+   *
+   * @param ptrs
+   * @param n
+   */
+  void deallocate_bulk(_T *const *ptrs, size_t n) {
+    _pool->deallocate_bulk(reinterpret_cast<void *const *>(ptrs), n);
+  }
+
+  /// slabs held by the pool
+  size_t slab_count() const { //
+    return _pool->slab_count();
+  }
+
+  /// true if no other copy shares the pools (they go with this one)
+  bool unique() const { //
+    return _pools.use_count() == 1;
+  }
+
+  template <typename _U>
+  bool operator==(const LockedHashSlabAllocator<_U> &o) const {
+    return _pools == o._pools;
+  }
+
+  template <typename _U>
+  bool operator!=(const LockedHashSlabAllocator<_U> &o) const {
+    return _pools != o._pools;
+  }
+};
+
+/**
+ * @brief true if _A frees many objects at once (deallocate_bulk)
+ */
+template <typename _A, typename = void>
+struct LockedHashHasBulkFree : std::false_type {};
+
+template <typename _A>
+struct LockedHashHasBulkFree<
+    _A, decltype(std::declval<_A &>().deallocate_bulk(
+            std::declval<typename _A::value_type *const *>(), size_t(0)))>
+    : std::true_type {};
+
+/**
+ * @brief true if _A keeps freed memory for objects of the same type until
+ * it is destroyed (lock-free readers may still read a freed node)
+ */
+template <typename _A> struct LockedHashIsTypeStable : std::false_type {};
+
+template <typename _T>
+struct LockedHashIsTypeStable<LockedHashSlabAllocator<_T>> : std::true_type {
+};
+
+/**
+ * @brief true if _A frees every object it allocated when its last copy is
+ * destroyed, so a table holding that copy may skip deallocating its nodes
+ * (_A::unique() tells if it is the last one)
+ */
+template <typename _A>
+struct LockedHashReleasesOnDestroy : std::false_type {};
+
+template <typename _T>
+struct LockedHashReleasesOnDestroy<LockedHashSlabAllocator<_T>>
+    : std::true_type {};
+
+#endif
@@ -0,0 +1,956 @@
+#ifndef __LOCKED_HASH_SPLITORDERED_HPP__
+#define __LOCKED_HASH_SPLITORDERED_HPP__
+
+#include <atomic>
+#include <lockedhash_base.hpp>
+#include <lockedhash_epoch.hpp>
+#include <lockedhash_hash.hpp>
+#include <lockedhash_index.hpp>
+#include <lockedhash_lock.hpp>
+#include <stdint.h>
+#include <vector>
+
+/// maximum number of bucket doublings (segments) of LockedHashSplitOrdered
+#define LOCKEDHASH_SPLITORDERED_MAX_LEVEL 40
+
+/**
+ * @brief LockedHash (LockedHashSplitOrdered storage)
+ *
+ * Lock-free split-ordered list (Shalev & Shavit). Every entry lives in one
+ * Harris-Michael linked list sorted by its bit-reversed hash, and a bucket
+ * is a pointer to a dummy node inside that list. Doubling the bucket count
+ * moves no entry: a new bucket is initialized on first use by inserting
+ * its dummy after the dummy of its parent bucket (recursively).
+ *
+ * search, insert, rm, find and expire never block; a thread descheduled in
+ * the middle of a call holds up no other thread. Calls run inside a
+ * LockedHashEpoch, and unlinked nodes and replaced values are freed once
+ * no thread can see them anymore.
+ *
+ * Values are immutable once published: an update (interceptor, find)
+ * copies the value, changes the copy and swaps it in with a CAS; if another
+ * writer got in first, it runs again on a fresh copy. loop and expire
+ * callbacks must not modify tp. Buckets are never merged back.
+ *
+ * @tparam _Key      Type of key objects.
+ * @tparam _Tp       Type of mapped objects.
+ * @tparam _Hash     Hashing function object type
+ * @tparam _MakeKey  Make Key function object type
+ * @tparam _KeyEqual Key equality function object type
+ * @tparam _KeyHash  Key hashing function object type
+ * @tparam _Alloc    Allocator type (rebound to the nodes and values)
+ */
+template <typename _Key, typename _Tp, typename _Hash, typename _MakeKey,
+          typename _KeyEqual, typename _KeyHash, typename _Alloc>
+class LockedHash<_Key, _Tp, _Hash, _MakeKey, LockedHashSplitOrdered,
+                 _KeyEqual, _KeyHash, _Alloc>
+    : public LockedHashBase<LockedHash<_Key, _Tp, _Hash, _MakeKey,
+                                       LockedHashSplitOrdered, _KeyEqual,
+                                       _KeyHash, _Alloc>,
+                            _Key, _Tp, _MakeKey, _KeyEqual, _KeyHash> {
+private:
+  typedef LockedHashBase<LockedHash, _Key, _Tp, _MakeKey, _KeyEqual, _KeyHash>
+      _Base;
+  friend _Base;
+  /// _compute runs fn again when it loses a race
+  static const bool _compute_retries = true;
+  using _Base::_hash;
+  using _Base::_makekey;
+  using _Base::_keyequal;
+
+private:
+  /**
+   * @brief node or value waiting for its epoch to pass
+   */
+  class LockedHashRetired {
+  public:
+    LockedHashRetired *retired_next = nullptr;
+    uint64_t retired_epoch = 0;
+    bool is_value;
+
+    LockedHashRetired(bool value) : is_value(value) {}
+  };
+
+  class LockedHashValue : public LockedHashRetired {
+  public:
+    _Tp _tp;
+
+    template <typename... _Args>
+    LockedHashValue(_Args &&...args)
+        : LockedHashRetired(true), _tp(std::forward<_Args>(args)...) {}
+  };
+
+  /**
+   * @brief LockedHashNode
+   * entry (odd _so_key) or bucket dummy (even _so_key, no value)
+   */
+  class LockedHashNode : public LockedHashRetired {
+  public:
+    /// bit-reversed hash (list order)
+    size_t _so_key;
+    /// mixed hash of the key (entries)
+    size_t _hashcode;
+    /// next node; the low bit is set once this node is removed
+    std::atomic<uintptr_t> next{0};
+    /// nullptr for dummies, and for entries being removed
+    std::atomic<LockedHashValue *> value{nullptr};
+    std::atomic<time_t> _timestamp{time(nullptr)};
+
+    LockedHashNode(size_t so_key, size_t hashcode)
+        : LockedHashRetired(false), _so_key(so_key), _hashcode(hashcode) {}
+  };
+
+  /// where a search stopped: *prev == cur, cur->_so_key >= the one searched
+  struct LockedHashPos {
+    std::atomic<uintptr_t> *prev;
+    LockedHashNode *cur;
+    uintptr_t next;
+  };
+
+  /**
+   * @brief epoch of one call
+   *
+   */
+  class LockedHashEpochScope {
+  private:
+    bool _inside = true;
+
+  public:
+    LockedHashEpochScope() { //
+      LockedHashEpoch::instance().enter();
+    }
+    LockedHashEpochScope(LockedHashEpochScope &&o) { //
+      o._inside = false;
+    }
+    ~LockedHashEpochScope() { //
+      release();
+    }
+
+    void release() {
+      if (_inside) {
+        LockedHashEpoch::instance().exit();
+        _inside = false;
+      }
+    }
+  };
+
+public:
+  /// read-only snapshot of a value, kept alive by an epoch (access_shared)
+  typedef LockedHashAccessor<const _Tp, LockedHashEpochScope> const_accessor;
+
+private:
+
+  typedef typename std::allocator_traits<_Alloc>::template rebind_alloc<
+      LockedHashNode>
+      _NodeAlloc;
+  typedef std::allocator_traits<_NodeAlloc> _NodeTraits;
+  typedef typename std::allocator_traits<_Alloc>::template rebind_alloc<
+      LockedHashValue>
+      _ValueAlloc;
+  typedef std::allocator_traits<_ValueAlloc> _ValueTraits;
+  typedef std::atomic<LockedHashNode *> _Bucket;
+
+private:
+  _NodeAlloc _node_alloc;
+  _ValueAlloc _value_alloc;
+  /// bucket segments (dummy of each bucket, nullptr until first use)
+  /// [0] initial buckets, [k] buckets added by the k-th doubling
+  std::atomic<_Bucket *> _segments[LOCKEDHASH_SPLITORDERED_MAX_LEVEL + 1];
+  /// initial bucket size (2^n)
+  size_t _bucket_size;
+  size_t _bucket_size_log2;
+  size_t _max_bucket_count;
+  /// current bucket count (2^n)
+  std::atomic<size_t> _bucket_count;
+  /// total elements
+  LockedHashCounter _size;
+  /// double bucket_count() when size() > bucket_count() * _max_load_factor
+  double _max_load_factor = 2.0;
+
+  /// retired nodes and values (lock-free stack)
+  std::atomic<LockedHashRetired *> _retired{nullptr};
+  std::atomic<size_t> _retired_count{0};
+  std::atomic<bool> _reclaiming{false};
+
+  time_t _expire_time = 0;
+
+private:
+  static size_t _log2(size_t n) { //
+    return 63 - __builtin_clzl(n);
+  }
+
+  static size_t _reverse(size_t x) {
+    const size_t m4 = 0x0f0f0f0f0f0f0f0fULL;
+    const size_t m2 = 0x3333333333333333ULL;
+    const size_t m1 = 0x5555555555555555ULL;
+    x = __builtin_bswap64(x);
+    x = ((x >> 4) & m4) | ((x & m4) << 4);
+    x = ((x >> 2) & m2) | ((x & m2) << 2);
+    x = ((x >> 1) & m1) | ((x & m1) << 1);
+    return x;
+  }
+
+  static size_t _so_entry(size_t hash) { //
+    return _reverse(hash) | 1;
+  }
+
+  static size_t _so_dummy(size_t bucket) { //
+    return _reverse(bucket);
+  }
+
+  static LockedHashNode *_ptr(uintptr_t p) {
+    return reinterpret_cast<LockedHashNode *>(p & ~(uintptr_t)1);
+  }
+
+  static bool _marked(uintptr_t p) { //
+    return p & 1;
+  }
+
+  LockedHashNode *_new_node(size_t so_key, size_t hashcode) {
+    LockedHashNode *c = _NodeTraits::allocate(_node_alloc, 1);
+    _NodeTraits::construct(_node_alloc, c, so_key, hashcode);
+    return c;
+  }
+
+  template <typename... _Args> LockedHashValue *_new_value(_Args &&...args) {
+    LockedHashValue *v = _ValueTraits::allocate(_value_alloc, 1);
+    try {
+      _ValueTraits::construct(_value_alloc, v, std::forward<_Args>(args)...);
+    } catch (...) {
+      _ValueTraits::deallocate(_value_alloc, v, 1);
+      throw;
+    }
+    return v;
+  }
+
+  void _delete_value(LockedHashValue *v) {
+    _ValueTraits::destroy(_value_alloc, v);
+    _ValueTraits::deallocate(_value_alloc, v, 1);
+  }
+
+  /// free a node no thread can see, with its value
+  void _delete_node(LockedHashNode *c) {
+    LockedHashValue *v = c->value.load(std::memory_order_relaxed);
+    if (v) {
+      _delete_value(v);
+    }
+    _NodeTraits::destroy(_node_alloc, c);
+    _NodeTraits::deallocate(_node_alloc, c, 1);
+  }
+
+  void _delete_retired(LockedHashRetired *r) {
+    if (r->is_value) {
+      _delete_value(static_cast<LockedHashValue *>(r));
+    } else {
+      _delete_node(static_cast<LockedHashNode *>(r));
+    }
+  }
+
+  /**
+   * @brief free r once every thread inside an epoch now has left
+   */
+  void _retire(LockedHashRetired *r) {
+    r->retired_epoch = LockedHashEpoch::instance().current();
+    r->retired_next = _retired.load(std::memory_order_relaxed);
+    while (!_retired.compare_exchange_weak(r->retired_next, r,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+    }
+    if (++_retired_count % LOCKEDHASH_EPOCH_RECLAIM == 0) {
+      _reclaim();
+    }
+  }
+
+  /// free retired nodes and values that no thread can see anymore
+  void _reclaim() {
+    if (_reclaiming.exchange(true, std::memory_order_acquire)) {
+      return;
+    }
+    uint64_t safe = LockedHashEpoch::instance().reclaimable();
+    LockedHashRetired *r =
+        _retired.exchange(nullptr, std::memory_order_acquire);
+    LockedHashRetired *keep = nullptr, *tail = nullptr;
+    while (r) {
+      LockedHashRetired *next = r->retired_next;
+      if (r->retired_epoch < safe) {
+        _delete_retired(r);
+      } else {
+        r->retired_next = keep;
+        if (keep == nullptr) {
+          tail = r;
+        }
+        keep = r;
+      }
+      r = next;
+    }
+    if (keep) {
+      tail->retired_next = _retired.load(std::memory_order_relaxed);
+      while (!_retired.compare_exchange_weak(tail->retired_next, keep,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed)) {
+      }
+    }
+    _reclaiming.store(false, std::memory_order_release);
+  }
+
+  /// segment of bucket, with its length n and the offset of bucket in it
+  size_t _segment(size_t bucket, size_t &n, size_t &off) {
+    if (bucket < _bucket_size) {
+      n = _bucket_size;
+      off = bucket;
+      return 0;
+    }
+    size_t seg = _log2(bucket) - _bucket_size_log2 + 1;
+    n = _bucket_size << (seg - 1);
+    off = bucket - n;
+    return seg;
+  }
+
+  /// dummy slot of bucket (its segment is allocated on first use)
+  _Bucket &_slot(size_t bucket) {
+    size_t n, off;
+    size_t seg = _segment(bucket, n, off);
+    _Bucket *s = _segments[seg].load(std::memory_order_acquire);
+    if (s == nullptr) {
+      _Bucket *fresh = new _Bucket[n]();
+      if (_segments[seg].compare_exchange_strong(s, fresh)) {
+        s = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    return s[off];
+  }
+
+  /**
+   * @brief dummy node of bucket, inserted after the dummy of its parent
+   * bucket (bucket without its highest bit) if not there yet
+   */
+  LockedHashNode *_get_bucket(size_t bucket) {
+    _Bucket &slot = _slot(bucket);
+    LockedHashNode *d = slot.load(std::memory_order_acquire);
+    if (d) {
+      return d;
+    }
+    LockedHashNode *head =
+        _get_bucket(bucket & ~((size_t)1 << _log2(bucket)));
+    d = _new_node(_so_dummy(bucket), bucket);
+    LockedHashPos pos;
+    for (;;) {
+      if (_list_find(head, d->_so_key, 0, (const _Key *)nullptr, pos)) {
+        // another thread initialized it
+        _delete_node(d);
+        d = pos.cur;
+        break;
+      }
+      d->next.store((uintptr_t)pos.cur, std::memory_order_relaxed);
+      uintptr_t expected = (uintptr_t)pos.cur;
+      if (pos.prev->compare_exchange_strong(expected, (uintptr_t)d,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    slot.store(d, std::memory_order_release);
+    return d;
+  }
+
+  LockedHashNode *_get_bucket_of(size_t hash) {
+    return _get_bucket(hash & (_bucket_count.load() - 1));
+  }
+
+  /// dummy slot of the bucket of hash, then the dummy (_Base::_batch).
+  /// nothing is allocated: a bucket not used yet is left alone.
+  void _prefetch(size_t hash, int stage) {
+    size_t bucket = LockedHashFmix::mix(hash) &
+                    (_bucket_count.load(std::memory_order_relaxed) - 1);
+    size_t n, off;
+    size_t seg = _segment(bucket, n, off);
+    _Bucket *s = _segments[seg].load(std::memory_order_acquire);
+    if (s == nullptr) {
+      return;
+    }
+    if (stage == 0) {
+      LOCKEDHASH_PREFETCH(&s[off]);
+    } else {
+      LOCKEDHASH_PREFETCH(s[off].load(std::memory_order_acquire));
+    }
+  }
+
+  /**
+   * @brief search the list from head (Harris-Michael), unlinking removed
+   * nodes on the way
+   *
+   * @param key  nullptr: the dummy of so_key
+   * @return true  pos.cur is the node searched
+   * @return false pos is where it would be inserted
+   */
+  template <typename _K>
+  bool _list_find(LockedHashNode *head, size_t so_key, size_t hash,
+                  const _K *key, LockedHashPos &pos) {
+  retry:
+    pos.prev = &head->next;
+    pos.cur = _ptr(pos.prev->load(std::memory_order_acquire));
+    for (;;) {
+      if (pos.cur == nullptr) {
+        return false;
+      }
+      pos.next = pos.cur->next.load(std::memory_order_acquire);
+      if (_marked(pos.next)) {
+        uintptr_t expected = (uintptr_t)pos.cur;
+        if (!pos.prev->compare_exchange_strong(expected, pos.next & ~1,
+                                               std::memory_order_acq_rel)) {
+          goto retry;
+        }
+        _retire(pos.cur);
+        pos.cur = _ptr(pos.next);
+        continue;
+      }
+      if (pos.cur->_so_key > so_key) {
+        return false;
+      }
+      if (pos.cur->_so_key == so_key) {
+        if (key == nullptr) {
+          if ((so_key & 1) == 0) {
+            return true;
+          }
+        } else if (pos.cur->_hashcode == hash) {
+          LockedHashValue *v = pos.cur->value.load(std::memory_order_acquire);
+          if (v && _keyequal(_makekey(v->_tp), *key)) {
+            return true;
+          }
+        }
+      }
+      pos.prev = &pos.cur->next;
+      pos.cur = _ptr(pos.next);
+    }
+  }
+
+  /// entry of key, nullptr if none (inside an epoch)
+  template <typename _K> LockedHashNode *_lookup(const _K &key, size_t hash) {
+    LockedHashPos pos;
+    if (_list_find(_get_bucket_of(hash), _so_entry(hash), hash, &key, pos)) {
+      return pos.cur;
+    }
+    return nullptr;
+  }
+
+  /// logically remove c; false if another thread removed it first
+  static bool _mark(LockedHashNode *c) {
+    uintptr_t next = c->next.load(std::memory_order_acquire);
+    while (!_marked(next)) {
+      if (c->next.compare_exchange_weak(next, next | 1,
+                                        std::memory_order_acq_rel)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief remove entry c and unlink it
+   *
+   * @return LockedHashValue* its value (to retire), nullptr if another
+   * thread removed c first
+   */
+  LockedHashValue *_take(LockedHashNode *c) {
+    if (!_mark(c)) {
+      return nullptr;
+    }
+    LockedHashValue *v = c->value.exchange(nullptr, std::memory_order_acq_rel);
+    _size.add(-1);
+    // a walk past c unlinks it
+    LockedHashPos pos;
+    _list_find(_get_bucket_of(c->_hashcode), c->_so_key, 0,
+               (const _Key *)nullptr, pos);
+    return v;
+  }
+
+  /**
+   * @brief call f on a copy of the value of c, and publish the copy
+   *
+   * @return false c was removed meanwhile
+   */
+  template <typename _F> bool _update(LockedHashNode *c, _F &f) {
+    LockedHashValue *v = c->value.load(std::memory_order_acquire);
+    while (v) {
+      LockedHashValue *n = _new_value(v->_tp);
+      f(n->_tp);
+      if (c->value.compare_exchange_strong(v, n, std::memory_order_acq_rel,
+                                           std::memory_order_acquire)) {
+        _retire(v);
+        return true;
+      }
+      _delete_value(n);
+    }
+    return false;
+  }
+
+  void _grow() {
+    size_t count = _bucket_count.load(std::memory_order_relaxed);
+    if (_max_load_factor > 0 && count < _max_bucket_count &&
+        _size.load_relaxed() > count * _max_load_factor) {
+      _bucket_count.compare_exchange_strong(count, count * 2);
+    }
+  }
+
+  /// call f(c) on each entry in list order (inside an epoch)
+  template <typename _F> void _for_each(_F f) {
+    LockedHashNode *c = _get_bucket(0);
+    while (c) {
+      if ((c->_so_key & 1) &&
+          !_marked(c->next.load(std::memory_order_acquire))) {
+        f(c);
+      }
+      c = _ptr(c->next.load(std::memory_order_acquire));
+    }
+  }
+
+  /**
+   * @brief insert or update or search (core of operator())
+   *
+   * @param key
+   * @param hash  _hash(key)
+   * @param tp
+   * @param interceptor
+   * @return tl::optional<_Tp>
+   */
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _insert(const _K &key, size_t hash, //
+                            tl::optional<_Tp> &tp,      //
+                            _F &interceptor) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashEpochScope epoch;
+    LockedHashNode *head = _get_bucket_of(hash);
+    size_t so_key = _so_entry(hash);
+    LockedHashNode *n = nullptr;
+    LockedHashValue *v = nullptr;
+    LockedHashPos pos;
+
+    for (;;) {
+      if (_list_find(head, so_key, hash, &key, pos)) {
+        if (n) {
+          _delete_node(n);
+        }
+        LockedHashNode *c = pos.cur;
+        if (!tp.has_value()) {
+          // only search
+          LockedHashValue *cv = c->value.load(std::memory_order_acquire);
+          return cv ? tl::make_optional<_Tp>(cv->_tp) : tl::nullopt;
+        }
+        if (LockedHashCallback::set(interceptor) && _update(c, interceptor)) {
+          // update data
+          c->_timestamp = time(nullptr);
+        }
+        return tl::nullopt;
+      }
+      if (!tp.has_value()) {
+        return tl::nullopt;
+      }
+      if (n == nullptr) {
+        v = _new_value(std::move(*tp));
+        n = _new_node(so_key, hash);
+        n->value.store(v, std::memory_order_relaxed);
+      }
+      n->next.store((uintptr_t)pos.cur, std::memory_order_relaxed);
+      uintptr_t expected = (uintptr_t)pos.cur;
+      if (pos.prev->compare_exchange_strong(expected, (uintptr_t)n,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    _size.add(1);
+    _grow();
+    // v stays readable until the epoch ends, even if already replaced
+    return tl::make_optional<_Tp>(v->_tp);
+  }
+
+  /// construct a value for key in place, unless key is there already
+  template <typename _K, typename... _Args>
+  bool _emplace(const _K &key, size_t hash, _Args &&...args) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashEpochScope epoch;
+    LockedHashNode *head = _get_bucket_of(hash);
+    size_t so_key = _so_entry(hash);
+    LockedHashNode *n = nullptr;
+    LockedHashPos pos;
+
+    for (;;) {
+      if (_list_find(head, so_key, hash, &key, pos)) {
+        if (n) {
+          _delete_node(n);
+        }
+        return false;
+      }
+      if (n == nullptr) {
+        LockedHashValue *v = _new_value(std::forward<_Args>(args)...);
+        n = _new_node(so_key, hash);
+        n->value.store(v, std::memory_order_relaxed);
+      }
+      n->next.store((uintptr_t)pos.cur, std::memory_order_relaxed);
+      uintptr_t expected = (uintptr_t)pos.cur;
+      if (pos.prev->compare_exchange_strong(expected, (uintptr_t)n,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    _size.add(1);
+    _grow();
+    return true;
+  }
+
+  /**
+   * @brief compute(): fn changes a copy that is swapped in, or creates a
+   * value that is linked in. fn runs again on the current entry if a
+   * concurrent writer got there first.
+   */
+  template <typename _K, typename _F>
+  LockedHashOutcome _compute(const _K &key, size_t hash, _F &fn) {
+    size_t mixed = LockedHashFmix::mix(hash);
+    LockedHashEpochScope epoch;
+
+    for (;;) {
+      LockedHashNode *c = _lookup(key, mixed);
+      if (c) {
+        bool erase = false;
+        auto f = [&fn, &erase](_Tp &tp) {
+          erase = LockedHashEntry<_Tp>::update(fn, tp);
+        };
+        if (!_update(c, f)) {
+          // removed meanwhile
+          continue;
+        }
+        if (!erase) {
+          c->_timestamp = time(nullptr);
+          return LockedHashOutcome::updated;
+        }
+        LockedHashValue *v = _take(c);
+        if (v) {
+          _retire(v);
+        }
+        return LockedHashOutcome::removed;
+      }
+      tl::optional<_Tp> tp = LockedHashEntry<_Tp>::create(fn);
+      if (!tp.has_value()) {
+        return LockedHashOutcome::absent;
+      }
+      if (_emplace(key, hash, std::move(*tp))) {
+        return LockedHashOutcome::inserted;
+      }
+    }
+  }
+
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _rm(const _K &key, size_t hash, _F &rmf) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashEpochScope epoch;
+
+    for (;;) {
+      LockedHashNode *c = _lookup(key, hash);
+      if (c == nullptr) {
+        return tl::nullopt;
+      }
+      LockedHashValue *v = c->value.load(std::memory_order_acquire);
+      if (v == nullptr || (LockedHashCallback::set(rmf) && !rmf(v->_tp))) {
+        return tl::nullopt;
+      }
+      v = _take(c);
+      if (v) {
+        tl::optional<_Tp> opt = tl::make_optional<_Tp>(v->_tp);
+        _retire(v);
+        return opt;
+      }
+    }
+  }
+
+  template <typename _K, typename _F>
+  void _find(const _K &key, size_t hash, _F &findf) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashEpochScope epoch;
+
+    LockedHashNode *c = _lookup(key, hash);
+    if (c) {
+      _update(c, findf);
+    }
+  }
+
+  template <typename _K, typename _F>
+  void _find_shared(const _K &key, size_t hash, _F &findf) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashEpochScope epoch;
+
+    LockedHashNode *c = _lookup(key, hash);
+    if (c) {
+      LockedHashValue *v = c->value.load(std::memory_order_acquire);
+      if (v) {
+        findf(v->_tp);
+      }
+    }
+  }
+
+  template <typename _K> void _access(const _K &, size_t) {
+    static_assert(sizeof(_K) == 0,
+                  "LockedHashSplitOrdered replaces values instead of "
+                  "changing them in place: use find or access_shared");
+  }
+
+  /// the value stays valid until the accessor leaves the epoch, even if it
+  /// is replaced or removed meanwhile
+  template <typename _K>
+  const_accessor _access_shared(const _K &key, size_t hash) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashEpochScope epoch;
+
+    LockedHashNode *c = _lookup(key, hash);
+    LockedHashValue *v =
+        c ? c->value.load(std::memory_order_acquire) : nullptr;
+    return const_accessor(std::move(epoch), v ? &v->_tp : nullptr);
+  }
+
+  template <typename _K>
+  tl::optional<_Tp> _alive(const _K &key, size_t hash) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashEpochScope epoch;
+
+    LockedHashNode *c = _lookup(key, hash);
+    if (c == nullptr) {
+      return tl::nullopt;
+    }
+    c->_timestamp = time(nullptr);
+    LockedHashValue *v = c->value.load(std::memory_order_acquire);
+    return v ? tl::make_optional<_Tp>(v->_tp) : tl::nullopt;
+  }
+
+public:
+  /**
+   * @brief Construct a new LockedHash object
+   *
+   * @param bucket_size   initial bucket size, rounded up to 2^n
+   * @param expire_time   expire time (0: never expire)
+   * @param lock_stripes  unused (no locks)
+   * @param alloc         node and value allocator
+   */
+  LockedHash(size_t bucket_size, time_t expire_time = 0,
+             size_t lock_stripes = 0, const _Alloc &alloc = _Alloc())
+      : _node_alloc(alloc), _value_alloc(alloc) {
+    (void)lock_stripes;
+    LockedHashIndexMask mask;
+    _bucket_size = mask.init(bucket_size);
+    _bucket_size_log2 = _log2(_bucket_size);
+    size_t level = 0;
+    while (level < LOCKEDHASH_SPLITORDERED_MAX_LEVEL &&
+           _bucket_size_log2 + level < 62) {
+      level++;
+    }
+    _max_bucket_count = _bucket_size << level;
+    for (size_t i = 0; i <= LOCKEDHASH_SPLITORDERED_MAX_LEVEL; i++) {
+      _segments[i] = nullptr;
+    }
+    _slot(0) = _new_node(_so_dummy(0), 0);
+    _bucket_count = _bucket_size;
+    _expire_time = expire_time;
+  }
+
+  /**
+   * @brief Destroy the Locked Hash object
+   *
+   */
+  virtual ~LockedHash() {
+    LockedHashNode *c = _slot(0).load();
+    while (c) {
+      LockedHashNode *next = _ptr(c->next.load());
+      _delete_node(c);
+      c = next;
+    }
+    LockedHashRetired *r = _retired.load();
+    while (r) {
+      LockedHashRetired *next = r->retired_next;
+      _delete_retired(r);
+      r = next;
+    }
+    for (size_t i = 0; i <= LOCKEDHASH_SPLITORDERED_MAX_LEVEL; i++) {
+      delete[] _segments[i].load();
+    }
+  }
+
+  /**
+   * @brief total element size
+   *
+   * @return size_t
+   */
+  size_t size() { //
+    return _size.load();
+  }
+
+  /**
+   * @brief total element size, without reading the counters of the other
+   * threads (LockedHashCounter::load_relaxed)
+   *
+   * @return size_t
+   */
+  size_t size_relaxed() { //
+    return _size.load_relaxed();
+  }
+
+  /**
+   * @brief current bucket count (doubles with size)
+   *
+   * @return size_t
+   */
+  size_t bucket_count() { //
+    return _bucket_count.load();
+  }
+
+  /**
+   * @brief average elements per bucket
+   *
+   * @return double
+   */
+  double load_factor() { //
+    return (double)size() / bucket_count();
+  }
+
+  /**
+   * @brief grow threshold (0: never grow)
+   * set before the table is shared between threads.
+   *
+   * @param lf
+   */
+  void max_load_factor(double lf) { //
+    _max_load_factor = lf;
+  }
+
+  double max_load_factor() { //
+    return _max_load_factor;
+  }
+
+  /**
+   * @brief element number of each bucket
+   *
+   * @return std::vector<size_t>
+   */
+  std::vector<size_t> bucket_elements() {
+    LockedHashEpochScope epoch;
+    size_t mask = bucket_count() - 1;
+    std::vector<size_t> v(mask + 1, 0);
+    _for_each([&v, mask](LockedHashNode *c) { v[c->_hashcode & mask]++; });
+    return v;
+  }
+
+  void clear() {
+    LockedHashEpochScope epoch;
+    _for_each([this](LockedHashNode *c) {
+      LockedHashValue *v = _take(c);
+      if (v) {
+        _retire(v);
+      }
+    });
+  }
+
+private:
+  /**
+   * @brief core of loop()
+   * loopf 결과가 true인 경우 Node의 timestamp를 업데이트 한다.
+   * loopf must not modify tp.
+   *
+   * @param loopf
+   */
+  template <typename _F> void _loop(_F &loopf) {
+    LockedHashEpochScope epoch;
+    size_t mask = bucket_count() - 1;
+    _for_each([&loopf, mask](LockedHashNode *c) {
+      LockedHashValue *v = c->value.load(std::memory_order_acquire);
+      if (v && loopf(c->_hashcode & mask, c->_timestamp.load(), v->_tp)) {
+        c->_timestamp = time(nullptr);
+      }
+    });
+  }
+
+  /**
+   * @brief core of loop_shared()
+   *
+   * @param loopf
+   */
+  template <typename _F> void _loop_shared(_F &loopf) {
+    LockedHashEpochScope epoch;
+    size_t mask = bucket_count() - 1;
+    _for_each([&loopf, mask](LockedHashNode *c) {
+      LockedHashValue *v = c->value.load(std::memory_order_acquire);
+      if (v) {
+        loopf(c->_hashcode & mask, c->_timestamp.load(), v->_tp);
+      }
+    });
+  }
+
+  /**
+   * @brief core of loop_with_delete()
+   * loopf 결과가 true인 경우 Node를 제거한다.
+   *
+   * @param loopf
+   */
+  template <typename _F> void _loop_with_delete(_F &loopf) {
+    LockedHashEpochScope epoch;
+    size_t mask = bucket_count() - 1;
+    _for_each([this, &loopf, mask](LockedHashNode *c) {
+      LockedHashValue *v = c->value.load(std::memory_order_acquire);
+      if (v && loopf(c->_hashcode & mask, c->_timestamp.load(), v->_tp)) {
+        if ((v = _take(c)) != nullptr) {
+          _retire(v);
+        }
+      }
+    });
+  }
+
+  tl::optional<std::list<_Tp>> _expire() {
+    if (_expire_time == 0) {
+      return tl::nullopt;
+    }
+    time_t now = time(nullptr);
+    time_t expire_time = _expire_time;
+    auto expiref = [now, expire_time](_Tp &, time_t timestamp, void *) {
+      return now - timestamp > expire_time;
+    };
+    return _expire(expiref, nullptr);
+  }
+
+  template <typename _F>
+  tl::optional<std::list<_Tp>> _expire(_F &expiref, void *arg) {
+    std::list<_Tp> expired;
+
+    LockedHashEpochScope epoch;
+    _for_each([&](LockedHashNode *c) {
+      LockedHashValue *v = c->value.load(std::memory_order_acquire);
+      if (v && expiref(v->_tp, c->_timestamp.load(), arg)) {
+        if ((v = _take(c)) != nullptr) {
+          expired.push_back(v->_tp);
+          _retire(v);
+        }
+      }
+    });
+
+    return expired.empty() ? tl::nullopt
+                           : tl::make_optional(std::move(expired));
+  }
+
+  template <typename _F> void _showdata(_F &showdataf) {
+    LockedHashEpochScope epoch;
+    size_t mask = bucket_count() - 1;
+    _for_each([&showdataf, mask](LockedHashNode *c) {
+      LockedHashValue *v = c->value.load(std::memory_order_acquire);
+      if (v) {
+        showdataf(c->_hashcode & mask, v->_tp);
+      }
+    });
+  }
+
+  template <typename _F> void _showbucket(_F &showdataf) {
+    std::vector<size_t> v = bucket_elements();
+    for (size_t i = 0; i < v.size(); i++) {
+      showdataf(i, v[i]);
+    }
+  }
+};
+
+#endif
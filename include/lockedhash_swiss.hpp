@@ -0,0 +1,783 @@
+#ifndef __LOCKED_HASH_SWISS_HPP__
+#define __LOCKED_HASH_SWISS_HPP__
+
+#include <atomic>
+#include <lockedhash_base.hpp>
+#include <lockedhash_hash.hpp>
+#include <lockedhash_lock.hpp>
+#include <mutex>
+#include <new>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/// slots per control group
+#define LOCKEDHASH_SWISS_GROUP 16
+/// initial slots per shard
+#define LOCKEDHASH_SWISS_SHARD_SLOTS 128
+
+/**
+ * @brief 16 control bytes probed at once (SSE2, scalar fallback)
+ * control byte: 0x80 empty, 0xfe deleted, 0x00~0x7f full (7-bit hash)
+ *
+ */
+class LockedHashSwissGroup {
+public:
+  static const int8_t EMPTY = -128;
+  static const int8_t DELETED = -2;
+
+  /// slots whose control byte is h2
+  static uint32_t match(const int8_t *ctrl, int8_t h2) {
+#ifdef __SSE2__
+    __m128i c = _mm_loadu_si128((const __m128i *)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(h2)));
+#else
+    uint32_t m = 0;
+    for (int i = 0; i < LOCKEDHASH_SWISS_GROUP; i++) {
+      m |= (uint32_t)(ctrl[i] == h2) << i;
+    }
+    return m;
+#endif
+  }
+
+  /// empty slots
+  static uint32_t match_empty(const int8_t *ctrl) { //
+    return match(ctrl, EMPTY);
+  }
+
+  /// empty or deleted slots
+  static uint32_t match_free(const int8_t *ctrl) {
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    uint32_t m = 0;
+    for (int i = 0; i < LOCKEDHASH_SWISS_GROUP; i++) {
+      m |= (uint32_t)(ctrl[i] < 0) << i;
+    }
+    return m;
+#endif
+  }
+};
+
+/**
+ * @brief LockedHash (LockedHashSwiss storage)
+ *
+ * Entries live in flat slot arrays, 16 slots per group, with one control
+ * byte per slot. A lookup matches 16 control bytes with one SSE2 compare
+ * and touches a slot only on a 7-bit hash match.
+ *
+ * The table is split into shards of groups; each shard has its own lock
+ * and probe sequences never leave their shard, so the locking guarantees
+ * are the same as LockedHashChained. A shard grows (x2) on its own once
+ * 7/8 of its slots are used. "bucket" in the callbacks is the shard.
+ * Shards are cache line aligned, so neighbouring shards do not
+ * false-share.
+ *
+ * @tparam _Key      Type of key objects.
+ * @tparam _Tp       Type of mapped objects.
+ * @tparam _Hash     Hashing function object type
+ * @tparam _MakeKey  Make Key function object type
+ * @tparam _KeyEqual Key equality function object type
+ * @tparam _KeyHash  Key hashing function object type
+ * @tparam _Alloc    Allocator type (rebound to the slot arrays)
+ */
+template <typename _Key, typename _Tp, typename _Hash, typename _MakeKey,
+          typename _KeyEqual, typename _KeyHash, typename _Alloc>
+class LockedHash<_Key, _Tp, _Hash, _MakeKey, LockedHashSwiss, _KeyEqual,
+                 _KeyHash, _Alloc>
+    : public LockedHashBase<LockedHash<_Key, _Tp, _Hash, _MakeKey,
+                                       LockedHashSwiss, _KeyEqual, _KeyHash,
+                                       _Alloc>,
+                            _Key, _Tp, _MakeKey, _KeyEqual, _KeyHash> {
+private:
+  typedef LockedHashBase<LockedHash, _Key, _Tp, _MakeKey, _KeyEqual, _KeyHash>
+      _Base;
+  friend _Base;
+  using _Base::_hash;
+  using _Base::_makekey;
+  using _Base::_keyequal;
+
+private:
+  /**
+   * @brief LockedHashSlot
+   *
+   */
+  class LockedHashSlot {
+  public:
+    _Tp _tp;
+    time_t _timestamp = time(nullptr);
+
+    template <typename... _Args>
+    LockedHashSlot(_Args &&...args) : _tp(std::forward<_Args>(args)...) {}
+  };
+
+  typedef typename std::allocator_traits<_Alloc>::template rebind_alloc<
+      LockedHashSlot>
+      _SlotAlloc;
+  typedef std::allocator_traits<_SlotAlloc> _SlotTraits;
+
+  /**
+   * @brief LockedHashShard
+   * ctrl/slots are allocated on the first insert.
+   */
+  class LockedHashShard {
+  public:
+    std::recursive_mutex lock;
+    /// recursion depth of lock (a shard is never resized under a walk)
+    size_t depth = 0;
+    int8_t *ctrl = nullptr;
+    LockedHashSlot *slots = nullptr;
+    size_t groups = 0;
+    size_t elements = 0;
+    /// empty slots usable before the shard has to grow
+    size_t growth_left = 0;
+  };
+
+  class LockedHashGuard {
+  private:
+    LockedHashShard *_shard;
+
+  public:
+    LockedHashGuard(LockedHashShard &shard) : _shard(&shard) {
+      _shard->lock.lock();
+      _shard->depth++;
+    }
+    LockedHashGuard(LockedHashGuard &&o) : _shard(o._shard) {
+      o._shard = nullptr;
+    }
+    ~LockedHashGuard() { //
+      release();
+    }
+
+    void release() {
+      if (_shard) {
+        _shard->depth--;
+        _shard->lock.unlock();
+        _shard = nullptr;
+      }
+    }
+  };
+
+public:
+  /// value in place, shard lock held (access)
+  typedef LockedHashAccessor<_Tp, LockedHashGuard> accessor;
+  /// read-only value in place, shard lock held (access_shared)
+  typedef LockedHashAccessor<const _Tp, LockedHashGuard> const_accessor;
+
+private:
+
+  static const size_t NPOS = (size_t)-1;
+
+private:
+  /// slot array allocator
+  _SlotAlloc _alloc;
+  LockedHashStripes<LockedHashShard> _shards;
+  /// number of shards (power of 2)
+  size_t _shard_count;
+  size_t _shard_bits;
+  /// total elements
+  LockedHashCounter _size;
+
+  time_t _expire_time = 0;
+
+private:
+  /// control byte of a hash mixed by LockedHashFmix::mix (all bits mixed,
+  /// so the low 7 and the shard/probe bits above them are independent)
+  static int8_t _h2(size_t hash) { //
+    return (int8_t)(hash & 0x7f);
+  }
+
+  LockedHashShard &_get_shard(size_t hash) {
+    return _shards.of(hash >> 7);
+  }
+
+  /// shard of hash (_Base::_batch)
+  size_t _stripe(size_t hash) {
+    return (LockedHashFmix::mix(hash) >> 7) & (_shard_count - 1);
+  }
+
+  /// shard lock of hash. depth is left alone: the cores called under it
+  /// may still grow the shard.
+  std::unique_lock<std::recursive_mutex> _lock_stripe(size_t hash, bool) {
+    return std::unique_lock<std::recursive_mutex>(
+        _get_shard(LockedHashFmix::mix(hash)).lock);
+  }
+
+  /// shard of hash, then its first probe group (read racily: only
+  /// prefetched)
+  void _prefetch(size_t hash, int stage) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    if (stage == 0) {
+      LOCKEDHASH_PREFETCH(&sh);
+      return;
+    }
+    size_t groups = LockedHashRacy::load(sh.groups);
+    if (groups == 0) {
+      return;
+    }
+    size_t g = (_probe_start(hash) & (groups - 1)) * LOCKEDHASH_SWISS_GROUP;
+    LOCKEDHASH_PREFETCH(LockedHashRacy::load(sh.ctrl) + g);
+    LOCKEDHASH_PREFETCH(LockedHashRacy::load(sh.slots) + g);
+  }
+
+  size_t _probe_start(size_t hash) { //
+    return hash >> (7 + _shard_bits);
+  }
+
+  /**
+   * @brief slot index of key in shard, NPOS if not found
+   */
+  template <typename _K>
+  size_t _find_slot(LockedHashShard &sh, const _K &key, size_t hash) {
+    if (sh.groups == 0) {
+      return NPOS;
+    }
+    size_t mask = sh.groups - 1;
+    size_t g = _probe_start(hash) & mask;
+    int8_t h2 = _h2(hash);
+    for (size_t i = 0; i < sh.groups; i++) {
+      const int8_t *ctrl = sh.ctrl + g * LOCKEDHASH_SWISS_GROUP;
+      uint32_t m = LockedHashSwissGroup::match(ctrl, h2);
+      while (m) {
+        size_t idx = g * LOCKEDHASH_SWISS_GROUP + __builtin_ctz(m);
+        if (_keyequal(_makekey(sh.slots[idx]._tp), key)) {
+          return idx;
+        }
+        m &= m - 1;
+      }
+      if (LockedHashSwissGroup::match_empty(ctrl)) {
+        return NPOS;
+      }
+      g = (g + i + 1) & mask;
+    }
+    return NPOS;
+  }
+
+  /**
+   * @brief first empty or deleted slot on the probe sequence of hash
+   */
+  size_t _find_free(LockedHashShard &sh, size_t hash) {
+    if (sh.groups == 0) {
+      return NPOS;
+    }
+    size_t mask = sh.groups - 1;
+    size_t g = _probe_start(hash) & mask;
+    for (size_t i = 0; i < sh.groups; i++) {
+      uint32_t m = LockedHashSwissGroup::match_free(sh.ctrl + //
+                                                    g * LOCKEDHASH_SWISS_GROUP);
+      if (m) {
+        return g * LOCKEDHASH_SWISS_GROUP + __builtin_ctz(m);
+      }
+      g = (g + i + 1) & mask;
+    }
+    return NPOS;
+  }
+
+  /**
+   * @brief grow x2 (or drop tombstones in place) and reinsert all slots
+   */
+  void _resize(LockedHashShard &sh) {
+    size_t capacity = sh.groups * LOCKEDHASH_SWISS_GROUP;
+    size_t groups = sh.groups;
+    if (groups == 0) {
+      groups = LOCKEDHASH_SWISS_SHARD_SLOTS / LOCKEDHASH_SWISS_GROUP;
+    } else if (sh.elements * 16 > capacity * 7) {
+      groups *= 2;
+    }
+    int8_t *old_ctrl = sh.ctrl;
+    LockedHashSlot *old_slots = sh.slots;
+
+    sh.groups = groups;
+    sh.ctrl = new int8_t[groups * LOCKEDHASH_SWISS_GROUP];
+    memset(sh.ctrl, LockedHashSwissGroup::EMPTY,
+           groups * LOCKEDHASH_SWISS_GROUP);
+    sh.slots = _SlotTraits::allocate(_alloc, groups * LOCKEDHASH_SWISS_GROUP);
+    sh.growth_left = groups * LOCKEDHASH_SWISS_GROUP * 7 / 8 - sh.elements;
+
+    for (size_t i = 0; i < capacity; i++) {
+      if (old_ctrl[i] < 0) {
+        continue;
+      }
+      size_t hash = LockedHashFmix::mix(_hash(_makekey(old_slots[i]._tp)));
+      size_t idx = _find_free(sh, hash);
+      sh.ctrl[idx] = _h2(hash);
+      new (&sh.slots[idx]) LockedHashSlot(std::move(old_slots[i]));
+      old_slots[i].~LockedHashSlot();
+    }
+    delete[] old_ctrl;
+    if (old_slots) {
+      _SlotTraits::deallocate(_alloc, old_slots, capacity);
+    }
+  }
+
+  /**
+   * @brief construct _Tp(args...) on the probe sequence of hash
+   *
+   * @return size_t slot index, NPOS if the shard is full and can not grow
+   * because a caller up the stack is walking it.
+   */
+  template <typename... _Args>
+  size_t _insert_slot(LockedHashShard &sh, size_t hash, _Args &&...args) {
+    size_t idx = _find_free(sh, hash);
+    if (idx == NPOS ||
+        (sh.growth_left == 0 && sh.ctrl[idx] == LockedHashSwissGroup::EMPTY)) {
+      if (sh.depth == 1) {
+        _resize(sh);
+        idx = _find_free(sh, hash);
+      } else if (idx == NPOS) {
+        return NPOS;
+      }
+    }
+    if (sh.ctrl[idx] == LockedHashSwissGroup::EMPTY && sh.growth_left > 0) {
+      sh.growth_left--;
+    }
+    new (&sh.slots[idx]) LockedHashSlot(std::forward<_Args>(args)...);
+    sh.ctrl[idx] = _h2(hash);
+    sh.elements++;
+    _size.add(1);
+    return idx;
+  }
+
+  void _erase_slot(LockedHashShard &sh, size_t idx) {
+    sh.slots[idx].~LockedHashSlot();
+    // a probe stops at a group with an empty slot, so the slot can be
+    // emptied instead of left as a tombstone
+    const int8_t *ctrl =
+        sh.ctrl + (idx / LOCKEDHASH_SWISS_GROUP) * LOCKEDHASH_SWISS_GROUP;
+    if (LockedHashSwissGroup::match_empty(ctrl)) {
+      sh.ctrl[idx] = LockedHashSwissGroup::EMPTY;
+      sh.growth_left++;
+    } else {
+      sh.ctrl[idx] = LockedHashSwissGroup::DELETED;
+    }
+    sh.elements--;
+    _size.add(-1);
+  }
+
+  size_t _capacity(LockedHashShard &sh) { //
+    return sh.groups * LOCKEDHASH_SWISS_GROUP;
+  }
+
+  /**
+   * @brief insert or update or search (core of operator())
+   *
+   * @param key
+   * @param hash  _hash(key)
+   * @param tp
+   * @param interceptor
+   * @return tl::optional<_Tp>
+   */
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _insert(const _K &key, size_t hash, //
+                            tl::optional<_Tp> &tp,      //
+                            _F &interceptor) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx != NPOS) {
+      LockedHashSlot &slot = sh.slots[idx];
+      if (!tp.has_value()) {
+        // only search
+        return tl::make_optional<_Tp>(slot._tp);
+      }
+      if (LockedHashCallback::set(interceptor)) {
+        // update data
+        interceptor(slot._tp);
+        slot._timestamp = time(nullptr);
+      }
+      return tl::nullopt;
+    }
+    if (!tp.has_value()) {
+      return tl::nullopt;
+    }
+
+    idx = _insert_slot(sh, hash, std::move(*tp));
+    if (idx == NPOS) {
+      return tl::nullopt;
+    }
+    return tl::make_optional<_Tp>(sh.slots[idx]._tp);
+  }
+
+  /// construct a value for key in place, unless key is there already
+  template <typename _K, typename... _Args>
+  bool _emplace(const _K &key, size_t hash, _Args &&...args) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    if (_find_slot(sh, key, hash) != NPOS) {
+      return false;
+    }
+    return _insert_slot(sh, hash, std::forward<_Args>(args)...) != NPOS;
+  }
+
+  /// one locked pass of compute(): fn creates, changes or removes the value
+  template <typename _K, typename _F>
+  LockedHashOutcome _compute(const _K &key, size_t hash, _F &fn) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx == NPOS) {
+      tl::optional<_Tp> tp = LockedHashEntry<_Tp>::create(fn);
+      if (!tp.has_value()) {
+        return LockedHashOutcome::absent;
+      }
+      if (_insert_slot(sh, hash, std::move(*tp)) == NPOS) {
+        return LockedHashOutcome::full;
+      }
+      return LockedHashOutcome::inserted;
+    }
+    LockedHashSlot &slot = sh.slots[idx];
+    if (LockedHashEntry<_Tp>::update(fn, slot._tp)) {
+      _erase_slot(sh, idx);
+      return LockedHashOutcome::removed;
+    }
+    slot._timestamp = time(nullptr);
+    return LockedHashOutcome::updated;
+  }
+
+  template <typename _K, typename _F>
+  tl::optional<_Tp> _rm(const _K &key, size_t hash, _F &rmf) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx == NPOS) {
+      return tl::nullopt;
+    }
+    if (LockedHashCallback::set(rmf) && !rmf(sh.slots[idx]._tp)) {
+      return tl::nullopt;
+    }
+    tl::optional<_Tp> opt(std::move(sh.slots[idx]._tp));
+    _erase_slot(sh, idx);
+    return opt;
+  }
+
+  template <typename _K, typename _F>
+  void _find(const _K &key, size_t hash, _F &findf) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx != NPOS) {
+      findf(sh.slots[idx]._tp);
+    }
+  }
+
+  /// shard locks are exclusive; same as _find
+  template <typename _K, typename _F>
+  void _find_shared(const _K &key, size_t hash, _F &findf) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx != NPOS) {
+      findf(sh.slots[idx]._tp);
+    }
+  }
+
+  template <typename _K> accessor _access(const _K &key, size_t hash) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    return accessor(std::move(guard),
+                    idx != NPOS ? &sh.slots[idx]._tp : nullptr);
+  }
+
+  template <typename _K>
+  const_accessor _access_shared(const _K &key, size_t hash) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    return const_accessor(std::move(guard),
+                          idx != NPOS ? &sh.slots[idx]._tp : nullptr);
+  }
+
+  template <typename _K>
+  tl::optional<_Tp> _alive(const _K &key, size_t hash) {
+    hash = LockedHashFmix::mix(hash);
+    LockedHashShard &sh = _get_shard(hash);
+    LockedHashGuard guard(sh);
+
+    size_t idx = _find_slot(sh, key, hash);
+    if (idx == NPOS) {
+      return tl::nullopt;
+    }
+    sh.slots[idx]._timestamp = time(nullptr);
+    return tl::make_optional<_Tp>(sh.slots[idx]._tp);
+  }
+
+  static size_t _shards_for(size_t bucket_size, size_t lock_stripes) {
+    if (lock_stripes) {
+      return lock_stripes;
+    }
+    size_t shard_slots = LOCKEDHASH_SWISS_SHARD_SLOTS;
+    return (bucket_size + shard_slots - 1) / shard_slots;
+  }
+
+public:
+  /**
+   * @brief Construct a new LockedHash object
+   *
+   * @param bucket_size   expected elements; sets the number of shards
+   *                      (bucket_size / LOCKEDHASH_SWISS_SHARD_SLOTS, 2^n)
+   * @param expire_time   expire time (0: never expire)
+   * @param lock_stripes  number of shards (locks), rounded up to 2^n
+   *                      (0: from bucket_size)
+   * @param alloc         slot array allocator
+   */
+  LockedHash(size_t bucket_size, time_t expire_time = 0,
+             size_t lock_stripes = 0, const _Alloc &alloc = _Alloc())
+      : _alloc(alloc), _shards(_shards_for(bucket_size, lock_stripes)) {
+    _shard_count = _shards.size();
+    _shard_bits = 0;
+    while ((1UL << _shard_bits) < _shard_count) {
+      _shard_bits++;
+    }
+    _expire_time = expire_time;
+  }
+
+  /**
+   * @brief Destroy the Locked Hash object
+   *
+   */
+  virtual ~LockedHash() {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.ctrl[i] >= 0) {
+          sh.slots[i].~LockedHashSlot();
+        }
+      }
+      delete[] sh.ctrl;
+      if (sh.slots) {
+        _SlotTraits::deallocate(_alloc, sh.slots, _capacity(sh));
+      }
+    }
+  }
+
+  /**
+   * @brief total element size
+   *
+   * @return size_t
+   */
+  size_t size() { //
+    return _size.load();
+  }
+
+  /**
+   * @brief total element size, without reading the counters of the other
+   * threads (LockedHashCounter::load_relaxed)
+   *
+   * @return size_t
+   */
+  size_t size_relaxed() { //
+    return _size.load_relaxed();
+  }
+
+  /**
+   * @brief number of shards
+   *
+   * @return size_t
+   */
+  size_t bucket_count() { //
+    return _shard_count;
+  }
+
+  /**
+   * @brief number of shard locks (= bucket_count())
+   *
+   * @return size_t
+   */
+  size_t lock_stripes() { //
+    return _shard_count;
+  }
+
+  /**
+   * @brief total slots allocated
+   *
+   * @return size_t
+   */
+  size_t capacity() {
+    size_t tot = 0;
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashGuard guard(_shards[s]);
+      tot += _capacity(_shards[s]);
+    }
+    return tot;
+  }
+
+  /**
+   * @brief element number of each shard
+   *
+   * @return std::vector<size_t>
+   */
+  std::vector<size_t> bucket_elements() {
+    std::vector<size_t> v;
+
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashGuard guard(_shards[s]);
+      v.push_back(_shards[s].elements);
+    }
+    return v;
+  }
+
+  void clear() {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.ctrl[i] >= 0) {
+          sh.slots[i].~LockedHashSlot();
+          _size.add(-1);
+        }
+      }
+      if (sh.groups) {
+        memset(sh.ctrl, LockedHashSwissGroup::EMPTY, _capacity(sh));
+      }
+      sh.elements = 0;
+      sh.growth_left = _capacity(sh) * 7 / 8;
+    }
+  }
+
+private:
+  /**
+   * @brief core of loop()
+   * loopf 결과가 true인 경우 Node의 timestamp를 업데이트 한다.
+   *
+   * @param loopf
+   */
+  template <typename _F> void _loop(_F &loopf) {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.ctrl[i] < 0) {
+          continue;
+        }
+        LockedHashSlot &slot = sh.slots[i];
+        if (loopf(s, slot._timestamp, slot._tp)) {
+          slot._timestamp = time(nullptr);
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief core of loop_shared()
+   * shard locks are exclusive; loop without the timestamp update.
+   *
+   * @param loopf
+   */
+  template <typename _F> void _loop_shared(_F &loopf) {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.ctrl[i] >= 0) {
+          loopf(s, sh.slots[i]._timestamp, sh.slots[i]._tp);
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief core of loop_with_delete()
+   * loopf 결과가 true인 경우 Node를 제거한다.
+   *
+   * @param loopf
+   */
+  template <typename _F> void _loop_with_delete(_F &loopf) {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.ctrl[i] < 0) {
+          continue;
+        }
+        LockedHashSlot &slot = sh.slots[i];
+        if (loopf(s, slot._timestamp, slot._tp)) {
+          _erase_slot(sh, i);
+        }
+      }
+    }
+  }
+
+  tl::optional<std::list<_Tp>> _expire() {
+    if (_expire_time == 0) {
+      return tl::nullopt;
+    }
+    time_t now = time(nullptr);
+    time_t expire_time = _expire_time;
+    auto expiref = [now, expire_time](_Tp &, time_t timestamp, void *) {
+      return now - timestamp > expire_time;
+    };
+    return _expire(expiref, nullptr);
+  }
+
+  template <typename _F>
+  tl::optional<std::list<_Tp>> _expire(_F &expiref, void *arg) {
+    std::list<_Tp> expired;
+
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.ctrl[i] < 0) {
+          continue;
+        }
+        LockedHashSlot &slot = sh.slots[i];
+        if (expiref(slot._tp, slot._timestamp, arg)) {
+          expired.push_back(std::move(slot._tp));
+          _erase_slot(sh, i);
+        }
+      }
+    }
+
+    return expired.empty() ? tl::nullopt
+                           : tl::make_optional(std::move(expired));
+  }
+
+  template <typename _F> void _showdata(_F &showdataf) {
+    for (size_t s = 0; s < _shard_count; s++) {
+      LockedHashShard &sh = _shards[s];
+      LockedHashGuard guard(sh);
+      if (sh.elements == 0) {
+        continue;
+      }
+      for (size_t i = 0; i < _capacity(sh); i++) {
+        if (sh.ctrl[i] >= 0) {
+          showdataf(s, sh.slots[i]._tp);
+        }
+      }
+    }
+  }
+
+  template <typename _F> void _showbucket(_F &showdataf) {
+    for (size_t s = 0; s < _shard_count; s++) {
+      size_t cnt;
+      {
+        LockedHashGuard guard(_shards[s]);
+        cnt = _shards[s].elements;
+      }
+      showdataf(s, cnt);
+    }
+  }
+};
+
+#endif
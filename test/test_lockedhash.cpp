@@ -1,6 +1,10 @@
 #include "lockedhash.hpp"
+#include "test_lockedhash_fixture.hpp"
 #include "gtest/gtest.h"
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <random>
 #include <string>
 #include <thread>
 #include <unistd.h>
@@ -8,33 +12,35 @@
 
 using namespace std;
 
-class TestClass {
-public:
-  string name = "";
-  int value = 0;
-  TestClass() {}
-  TestClass(const string &n) : TestClass() { name = n; }
-};
 
-struct TestClassHash {
-  size_t operator()(TestClass const &t) const noexcept {
-    return std::hash<string>{}(t.name);
+static size_t keyequal_calls = 0;
+struct CountingKeyEqual {
+  bool operator()(const string &a, const string &b) const {
+    keyequal_calls++;
+    return a == b;
   }
 };
-struct TestClassMakeKey {
-  string operator()(TestClass const &t) const noexcept { return t.name; }
-};
 
-void test_insert(
-    LockedHash<string, TestClass, TestClassHash, TestClassMakeKey> *hash,
-    size_t start, size_t amount) {
+/// hashes std::string and const char * alike
+struct TransparentHash {
+  typedef void is_transparent;
+  size_t operator()(const char *s) const noexcept {
+    size_t h = 14695981039346656037ULL;
+    while (*s) {
+      h = (h ^ (unsigned char)*s++) * 1099511628211ULL;
+    }
+    return h;
+  }
+  size_t operator()(const string &s) const noexcept {
+    return operator()(s.c_str());
+  }
+};
 
-  for (size_t i = start; i < start + amount; i++) {
-    TestClass t;
-    t.name = "k_" + to_string(i);
-    (*hash)(t);
+struct TestClassKeyRef {
+  const string &operator()(TestClass const &t) const noexcept {
+    return t.name;
   }
-}
+};
 
 TEST(LockedHash, operatorIndex) {
   size_t tot;
@@ -56,10 +62,12 @@ TEST(LockedHash, operatorIndex) {
   ASSERT_EQ(tot, hash.size());
 
   tot = 0;
-  hash.loop([&tot](size_t bucket, TestClass &t) {
+  hash.loop([&tot](size_t bucket, time_t timestamp, TestClass &t) {
     (void)bucket;
+    (void)timestamp;
     (void)t;
     tot += 1;
+    return false;
   });
   ASSERT_EQ(tot, hash.size());
 }
@@ -82,10 +90,12 @@ TEST(LockedHash, insertRvalue) {
   ASSERT_EQ(tot, hash.size());
 
   tot = 0;
-  hash.loop([&tot](size_t bucket, TestClass &t) {
+  hash.loop([&tot](size_t bucket, time_t timestamp, TestClass &t) {
     (void)bucket;
+    (void)timestamp;
     (void)t;
     tot += 1;
+    return false;
   });
   ASSERT_EQ(tot, hash.size());
 }
@@ -109,10 +119,12 @@ TEST(LockedHash, insertLvalue) {
   ASSERT_EQ(tot, hash.size());
 
   tot = 0;
-  hash.loop([&tot](size_t bucket, TestClass &t) {
+  hash.loop([&tot](size_t bucket, time_t timestamp, TestClass &t) {
     (void)bucket;
+    (void)timestamp;
     (void)t;
     tot += 1;
+    return false;
   });
   ASSERT_EQ(tot, hash.size());
 }
@@ -130,11 +142,12 @@ TEST(LockedHash, insert) {
   ASSERT_EQ(hash("KKK")->name, "KKK");
   ASSERT_EQ(1, hash.size());
 
-  // different key and class
+  // different key and class: not inserted, it could not be found
   auto k3 = hash("V1", TestClass("B1"));
-  ASSERT_EQ(k3->name, "B1");
-  ASSERT_EQ(hash("V1")->name, "B1");
-  ASSERT_EQ(2, hash.size());
+  ASSERT_EQ(k3.has_value(), false);
+  ASSERT_EQ(hash("V1").has_value(), false);
+  ASSERT_EQ(hash("B1").has_value(), false);
+  ASSERT_EQ(1, hash.size());
 }
 
 TEST(LockedHash, delete_with_key) {
@@ -208,7 +221,7 @@ TEST(LockedHash, threadSafe) {
   size_t thread_count = 16;
 
   for (size_t i = 1; i <= thread_count; i++) {
-    vs.push_back(thread(test_insert, &hash, i * amout, amout));
+    vs.push_back(thread(test_insert<decltype(hash)>, &hash, i * amout, amout));
   }
 
   for (auto &t : vs) {
@@ -238,18 +251,877 @@ TEST(LockedHash, inserter_updater) {
   auto a2 = hash["A2"];
   ASSERT_EQ(a2->value, 600);
 
-  hash.loop([](size_t bucket, TestClass &t) {
+  hash.loop([](size_t bucket, time_t timestamp, TestClass &t) {
     (void)bucket;
+    (void)timestamp;
     if (t.name == "A1") {
-      ASSERT_EQ(t.value, 500);
+      EXPECT_EQ(t.value, 500);
     }
     if (t.name == "A2") {
-      ASSERT_EQ(t.value, 600);
+      EXPECT_EQ(t.value, 600);
     }
+    return false;
   });
 }
 
+TEST(LockedHash, growAndShrink) {
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey> hash(3);
+  for (int i = 0; i < 10000; i++) {
+    hash(TestClass("A" + to_string(i)));
+  }
+  ASSERT_EQ(10000, hash.size());
+  ASSERT_GE(hash.bucket_count(), 10000 / hash.max_load_factor());
+  ASSERT_EQ(hash.bucket_elements().size(), hash.bucket_count());
+
+  size_t tot = 0;
+  for (auto &v : hash.bucket_elements()) {
+    tot += v;
+  }
+  ASSERT_EQ(tot, hash.size());
+  for (int i = 0; i < 10000; i++) {
+    ASSERT_EQ(hash("A" + to_string(i)).has_value(), true);
+  }
+
+  for (int i = 0; i < 9990; i++) {
+    ASSERT_EQ(hash.rm("A" + to_string(i)).has_value(), true);
+  }
+  while (hash.rehash_step(100)) {
+  }
+  ASSERT_EQ(10, hash.size());
+  ASSERT_LE(hash.bucket_count(), 10 / hash.min_load_factor() + 1);
+  for (int i = 9990; i < 10000; i++) {
+    ASSERT_EQ(hash("A" + to_string(i)).has_value(), true);
+  }
+
+  tot = 0;
+  hash.loop([&tot](size_t bucket, time_t timestamp, TestClass &t) {
+    (void)bucket;
+    (void)timestamp;
+    (void)t;
+    tot += 1;
+    return false;
+  });
+  ASSERT_EQ(tot, hash.size());
+}
+
+TEST(LockedHash, growThreadSafe) {
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey> hash(4);
+  vector<thread> vs;
+  for (size_t i = 1; i <= 8; i++) {
+    vs.push_back(thread(test_insert<decltype(hash)>, &hash, i * 1000, 1000));
+  }
+  // helper thread migrating alongside the inserters
+  std::atomic<bool> done(false);
+  thread helper([&]() {
+    while (!done) {
+      hash.rehash_step(8);
+    }
+  });
+  for (auto &t : vs) {
+    t.join();
+  }
+  done = true;
+  helper.join();
+
+  ASSERT_EQ(8000, hash.size());
+  ASSERT_GT(hash.bucket_count(), 4);
+  for (size_t i = 1000; i < 9000; i++) {
+    ASSERT_EQ(hash("k_" + to_string(i)).has_value(), true);
+  }
+}
+
+TEST(LockedHash, hashBeforeKeyEqual) {
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey,
+             LockedHashChained, CountingKeyEqual>
+      hash(1);
+  hash.max_load_factor(0);
+  for (int i = 0; i < 100; i++) {
+    hash(TestClass("A" + to_string(i)));
+  }
+  ASSERT_EQ(1, hash.bucket_count());
+
+  keyequal_calls = 0;
+  ASSERT_EQ(hash("A50")->name, "A50");
+  ASSERT_EQ(keyequal_calls, 1);
+
+  keyequal_calls = 0;
+  ASSERT_EQ(hash("B50").has_value(), false);
+  ASSERT_EQ(hash.rm("B50").has_value(), false);
+  ASSERT_EQ(keyequal_calls, 0);
+}
+
+TEST(LockedHash, transparentKey) {
+  LockedHash<string, TestClass, TestClassHash, TestClassKeyRef,
+             LockedHashChained, std::equal_to<>, TransparentHash>
+      hash(11);
+  for (int i = 0; i < 20; i++) {
+    hash(TestClass("A" + to_string(i)));
+  }
+
+  ASSERT_EQ(hash("A5")->name, "A5");
+  ASSERT_EQ(hash("B5").has_value(), false);
+  int value = 0;
+  hash.find("A6", [](TestClass &t) { t.value = 600; });
+  hash.find("A6", [&value](TestClass &t) { value = t.value; });
+  ASSERT_EQ(value, 600);
+  ASSERT_EQ(hash.alive("A7")->name, "A7");
+  ASSERT_EQ(hash.rm("A8")->name, "A8");
+  ASSERT_EQ(19, hash.size());
+  ASSERT_EQ(hash[string("A8")].has_value(), false);
+
+  LockedHash<string, TestClass, TestClassHash, TestClassKeyRef,
+             LockedHashSwiss, std::equal_to<>, TransparentHash>
+      swiss(11);
+  swiss(TestClass("S1"));
+  ASSERT_EQ(swiss("S1")->name, "S1");
+  ASSERT_EQ(swiss.rm("S1")->name, "S1");
+  ASSERT_EQ(0, swiss.size());
+}
+
+TEST(LockedHash, lockStripes) {
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey> deflt(100000);
+  ASSERT_EQ(LOCKEDHASH_LOCK_STRIPES, deflt.lock_stripes());
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey> few(3);
+  ASSERT_EQ(4, few.lock_stripes());
+
+  // 6 stripes (-> 8) over 100 home buckets
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey> hash(100, 0,
+                                                                      6);
+  ASSERT_EQ(8, hash.lock_stripes());
+  vector<thread> vs;
+  for (size_t i = 1; i <= 8; i++) {
+    vs.push_back(thread(test_insert<decltype(hash)>, &hash, i * 1000, 1000));
+  }
+  for (auto &t : vs) {
+    t.join();
+  }
+  ASSERT_EQ(8000, hash.size());
+  ASSERT_GT(hash.bucket_count(), 100);
+
+  // every bucket is walked once
+  vector<size_t> seen(hash.bucket_count(), 0);
+  hash.loop([&seen](size_t bucket, time_t, TestClass &) {
+    seen[bucket]++;
+    return false;
+  });
+  vector<size_t> elements = hash.bucket_elements();
+  ASSERT_EQ(seen, elements);
+
+  hash.loop_with_delete(
+      [](size_t, time_t, TestClass &t) { return t.name < "k_5"; });
+  ASSERT_EQ(4000, hash.size());
+  hash.clear();
+  ASSERT_EQ(0, hash.size());
+}
+
+using SharedHash =
+    LockedHash<string, TestClass, TestClassHash, TestClassMakeKey,
+               LockedHashChainedPolicy<LockedHashIndexModulo,
+                                       LockedHashSharedLock>>;
+
+TEST(LockedHash, sharedLock) {
+  SharedHash hash(4, 0, 2);
+  for (int i = 0; i < 100; i++) {
+    hash(TestClass("A" + to_string(i)));
+  }
+
+  // nested reads, and a read under a write of the same bucket
+  int value = 0;
+  hash.find_shared("A1", [&](const TestClass &t) {
+    hash.find_shared("A1", [&](const TestClass &u) { value = u.value; });
+    ASSERT_EQ(hash("A1")->name, t.name);
+  });
+  hash.find("A2", [&](TestClass &t) {
+    t.value = 2;
+    hash.find_shared("A2", [&](const TestClass &u) { value = u.value; });
+    hash.rm("A3");
+  });
+  ASSERT_EQ(value, 2);
+  ASSERT_EQ(99, hash.size());
+
+  size_t tot = 0;
+  hash.loop_shared([&](size_t, time_t, const TestClass &t) {
+    tot += hash(t.name).has_value();
+  });
+  ASSERT_EQ(tot, 99);
+
+  // readers and writers together
+  vector<thread> vs;
+  std::atomic<size_t> found(0);
+  for (int r = 0; r < 4; r++) {
+    vs.push_back(thread([&hash, &found]() {
+      for (int j = 0; j < 2000; j++) {
+        hash.find_shared("A" + to_string(j % 100),
+                         [&found](const TestClass &) { found++; });
+      }
+    }));
+  }
+  vs.push_back(thread([&hash]() {
+    for (int j = 0; j < 2000; j++) {
+      hash(TestClass("W" + to_string(j)));
+      hash.rm("W" + to_string(j - 1));
+    }
+  }));
+  for (auto &t : vs) {
+    t.join();
+  }
+  ASSERT_EQ(found.load(), 4 * 1980);
+  ASSERT_EQ(100, hash.size());
+}
+
+/// a == ~b in every consistent copy
+struct SeqValue {
+  size_t id;
+  size_t a;
+  size_t b;
+};
+struct SeqValueHash {
+  size_t operator()(SeqValue const &v) const noexcept { return v.id; }
+  size_t operator()(size_t id) const noexcept { return id; }
+};
+struct SeqValueMakeKey {
+  size_t operator()(SeqValue const &v) const noexcept { return v.id; }
+};
+
+using SeqHash = LockedHash<size_t, SeqValue, SeqValueHash, SeqValueMakeKey,
+                           LockedHashChainedPolicy<LockedHashIndexModulo,
+                                                   LockedHashSeqLock>,
+                           std::equal_to<size_t>, SeqValueHash,
+                           LockedHashSlabAllocator<SeqValue>>;
+
+TEST(LockedHash, seqLockRead) {
+  SeqHash hash(8, 0, 4);
+  for (size_t i = 0; i < 64; i++) {
+    hash(SeqValue{i, i, ~i});
+  }
+  ASSERT_EQ(hash((size_t)5)->a, 5);
+  ASSERT_EQ(hash((size_t)100).has_value(), false);
+
+  std::atomic<bool> done(false);
+  std::atomic<size_t> torn(0), reads(0);
+  vector<thread> readers;
+  for (int r = 0; r < 3; r++) {
+    readers.push_back(thread([&]() {
+      while (!done) {
+        for (size_t i = 0; i < 64; i++) {
+          auto v = hash(i);
+          if (v.has_value()) {
+            torn += (v->a != ~v->b) || v->id != i;
+            reads++;
+          }
+          hash.find_shared(i, [&](const SeqValue &s) {
+            torn += (s.a != ~s.b) || s.id != i;
+          });
+        }
+      }
+    }));
+  }
+  // writers: updates, and remove/insert cycles that recycle nodes
+  for (size_t n = 1; n < 3000 || reads < 3000; n++) {
+    size_t i = n % 64;
+    hash(i, [n](SeqValue &v) {
+      v.a = n;
+      v.b = ~n;
+    });
+    if (n % 3 == 0) {
+      hash.rm(i);
+      hash(SeqValue{i, n, ~n});
+    }
+  }
+  done = true;
+  for (auto &t : readers) {
+    t.join();
+  }
+  ASSERT_EQ(torn.load(), 0);
+  ASSERT_GT(reads.load(), 0);
+  ASSERT_EQ(64, hash.size());
+}
+
+/// s == to_string(n) in every value a reader sees
+struct EpochValue {
+  size_t id;
+  size_t n;
+  string s;
+};
+struct EpochValueHash {
+  size_t operator()(EpochValue const &v) const noexcept { return v.id; }
+  size_t operator()(size_t id) const noexcept { return id; }
+};
+struct EpochValueMakeKey {
+  size_t operator()(EpochValue const &v) const noexcept { return v.id; }
+};
+
+using EpochHash =
+    LockedHash<size_t, EpochValue, EpochValueHash, EpochValueMakeKey,
+               LockedHashChainedPolicy<LockedHashIndexModulo,
+                                       LockedHashEpochLock>>;
+
+TEST(LockedHash, epochLockRead) {
+  EpochHash hash(4, 0, 4);
+  for (size_t i = 0; i < 64; i++) {
+    hash(EpochValue{i, i, to_string(i)});
+  }
+  ASSERT_EQ(hash((size_t)5)->s, "5");
+  ASSERT_EQ(hash((size_t)100).has_value(), false);
+  hash.find((size_t)5, [](EpochValue &v) { v.s = "five"; });
+  ASSERT_EQ(hash((size_t)5)->s, "five");
+  hash((size_t)5, [](EpochValue &v) { v.s = "5"; });
+  ASSERT_EQ(hash((size_t)5)->s, "5");
+
+  std::atomic<bool> done(false);
+  std::atomic<size_t> torn(0), reads(0), misses(0);
+  vector<thread> readers;
+  for (int r = 0; r < 3; r++) {
+    readers.push_back(thread([&]() {
+      while (!done) {
+        for (size_t i = 0; i < 64; i++) {
+          auto v = hash(i);
+          if (v.has_value()) {
+            torn += v->s != to_string(v->n) || v->id != i;
+            reads++;
+          } else if (i % 3 != 0) {
+            misses++; // never removed
+          }
+          hash.find_shared(i, [&](const EpochValue &e) {
+            torn += e.s != to_string(e.n) || e.id != i;
+          });
+        }
+      }
+    }));
+  }
+  // writers: copy-on-write updates, removes, and splits/merges
+  for (size_t n = 64; n < 3000 || reads < 3000; n++) {
+    size_t i = n % 64;
+    hash(i, [n](EpochValue &v) {
+      v.n = n;
+      v.s = to_string(n);
+    });
+    if (i % 3 == 0) {
+      hash.rm(i);
+      hash(EpochValue{i, n, to_string(n)});
+    }
+    // grow and shrink the table under the readers
+    if (n % 1000 == 0) {
+      for (size_t k = 1000; k < 1200; k++) {
+        hash(EpochValue{k, k, to_string(k)});
+      }
+    } else if (n % 1000 == 500) {
+      for (size_t k = 1000; k < 1200; k++) {
+        hash.rm(k);
+      }
+    }
+  }
+  done = true;
+  for (auto &t : readers) {
+    t.join();
+  }
+  ASSERT_EQ(torn.load(), 0);
+  ASSERT_EQ(misses.load(), 0);
+  for (size_t k = 1000; k < 1200; k++) {
+    hash.rm(k);
+  }
+  ASSERT_EQ(64, hash.size());
+}
+
+TEST(LockedHash, sizeCounter) {
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey> hash(64);
+  for (int i = 0; i < 10; i++) {
+    hash(TestClass("S" + to_string(i)));
+  }
+  // the counts of this thread are always in
+  ASSERT_EQ(10, hash.size());
+  ASSERT_EQ(10, hash.size_relaxed());
+
+  vector<thread> vs;
+  for (int t = 0; t < 8; t++) {
+    vs.push_back(thread([&hash, t]() {
+      for (int i = 0; i < 1000; i++) {
+        hash(TestClass("T" + to_string(t) + "_" + to_string(i)));
+      }
+      for (int i = 0; i < 1000; i += 2) {
+        hash.rm("T" + to_string(t) + "_" + to_string(i));
+      }
+    }));
+  }
+  for (auto &t : vs) {
+    t.join();
+  }
+  ASSERT_EQ(10 + 8 * 500, hash.size());
+  size_t relaxed = hash.size_relaxed();
+  ASSERT_LE(relaxed, 10 + 8 * 500 + 8 * LOCKEDHASH_COUNTER_BATCH);
+  ASSERT_GE(relaxed + 8 * LOCKEDHASH_COUNTER_BATCH, 10 + 8 * 500);
+}
+
+TEST(LockedHash, accessor) {
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey> hash(4, 0, 2);
+  for (int i = 0; i < 100; i++) {
+    hash(TestClass("A" + to_string(i)));
+  }
+
+  // changed in place, no copy
+  if (auto a = hash.access("A1")) {
+    a->value = 1;
+    ASSERT_EQ((*a).name, "A1");
+    // the lock is recursive: calls of the same thread go through
+    ASSERT_EQ(hash("A1")->value, 1);
+    hash(TestClass("B1"));
+  } else {
+    FAIL();
+  }
+  ASSERT_EQ(hash("A1")->value, 1);
+  ASSERT_EQ(101, hash.size());
+  ASSERT_FALSE(hash.access("A5555"));
+  ASSERT_FALSE(hash.access_shared("A5555"));
+
+  auto c = hash.access_shared("A1");
+  ASSERT_TRUE(c);
+  auto moved = std::move(c);
+  ASSERT_FALSE(c);
+  ASSERT_EQ(moved->value, 1);
+  moved.release();
+  ASSERT_FALSE(moved);
+
+  // projections
+  ASSERT_EQ(*hash.apply("A2", [](TestClass &t) { return ++t.value; }), 1);
+  ASSERT_EQ(*hash.apply_shared("A2", [](const TestClass &t) { //
+    return t.name.size();
+  }),
+            2);
+  ASSERT_FALSE(hash.apply("A5555", [](TestClass &t) { return t.value; }));
+
+  // writers of a bucket wait for the accessor
+  vector<thread> vs;
+  for (int t = 0; t < 4; t++) {
+    vs.push_back(thread([&hash]() {
+      for (int j = 0; j < 1000; j++) {
+        if (auto a = hash.access("A" + to_string(j % 10))) {
+          a->value++;
+        }
+      }
+    }));
+  }
+  for (auto &t : vs) {
+    t.join();
+  }
+  int total = 0;
+  for (int i = 0; i < 10; i++) {
+    total += *hash.apply_shared("A" + to_string(i),
+                                [](const TestClass &t) { return t.value; });
+  }
+  ASSERT_EQ(total, 1 + 1 + 4 * 1000);
+}
+
+TEST(LockedHash, epochLockAccessShared) {
+  EpochHash hash(4);
+  hash(EpochValue{1, 1, "1"});
+  auto a = hash.access_shared((size_t)1);
+  ASSERT_TRUE(a);
+  ASSERT_EQ(a->s, "1");
+  a.release();
+  ASSERT_EQ(*hash.apply((size_t)1, [](EpochValue &v) {
+    v.s = "one";
+    return v.s.size();
+  }),
+            3);
+  ASSERT_EQ(hash.access_shared((size_t)1)->s, "one");
+}
+
+TEST(LockedHash, templateCallbacks) {
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey> hash(16);
+  for (int i = 0; i < 100; i++) {
+    hash(TestClass("A" + to_string(i)));
+  }
+
+  // move-only captures: no std::function can hold these
+  unique_ptr<int> one(new int(1));
+  hash.find("A1", [one = std::move(one)](TestClass &t) { t.value = *one; });
+  ASSERT_EQ(hash("A1")->value, 1);
+  hash("A2", [v = unique_ptr<int>(new int(2))](TestClass &t) {
+    t.value = *v;
+  });
+  ASSERT_EQ(hash("A2")->value, 2);
+
+  size_t n = 0;
+  hash.loop([&n](size_t, time_t, TestClass &) { return ++n, false; });
+  ASSERT_EQ(n, 100);
+  hash.loop_shared([&n](size_t, time_t, const TestClass &) { n--; });
+  ASSERT_EQ(n, 0);
+  hash.loop_with_delete([](size_t, time_t, TestClass &t) { //
+    return t.value == 2;
+  });
+  ASSERT_EQ(99, hash.size());
+  ASSERT_FALSE(hash.rm("A1", [](TestClass &) { return false; }));
+  ASSERT_TRUE(hash.rm("A1", [](TestClass &t) { return t.value == 1; }));
+  auto expired = hash.expire([](TestClass &t, time_t, void *) { //
+    return t.name == "A3";
+  });
+  ASSERT_EQ(expired->size(), 1);
+  ASSERT_EQ(97, hash.size());
+
+  // the std::function overloads still take an empty callback
+  std::function<bool(TestClass &)> keep = nullptr;
+  ASSERT_TRUE(hash.rm("A4", keep));
+  hash(TestClass("A5"), nullptr);
+  ASSERT_EQ(96, hash.size());
+}
+
+/// move-only value owning its payload
+struct MoveOnly {
+  size_t id;
+  unique_ptr<string> payload;
+  MoveOnly(size_t i, unique_ptr<string> p) : id(i), payload(std::move(p)) {}
+};
+struct MoveOnlyHash {
+  size_t operator()(MoveOnly const &v) const noexcept { return v.id; }
+  size_t operator()(size_t id) const noexcept { return id; }
+};
+struct MoveOnlyMakeKey {
+  size_t operator()(MoveOnly const &v) const noexcept { return v.id; }
+};
+
+template <typename _Storage> static void move_only() {
+  LockedHash<size_t, MoveOnly, MoveOnlyHash, MoveOnlyMakeKey, _Storage> hash(
+      4);
+  for (size_t i = 0; i < 2000; i++) {
+    ASSERT_TRUE(hash.try_emplace(i, i, unique_ptr<string>(new string(
+                                           to_string(i)))));
+  }
+  ASSERT_FALSE(hash.try_emplace(5, 5, nullptr));
+  ASSERT_TRUE(hash.emplace(2000, unique_ptr<string>(new string("2000"))));
+  ASSERT_FALSE(hash.emplace(MoveOnly(2000, nullptr)));
+  ASSERT_EQ(2001, hash.size());
+
+  ASSERT_EQ(*hash.apply_shared((size_t)7,
+                               [](const MoveOnly &v) { return *v.payload; }),
+            "7");
+  size_t n = 0;
+  hash.loop_shared([&n](size_t, time_t, const MoveOnly &v) {
+    n += *v.payload == to_string(v.id);
+  });
+  ASSERT_EQ(n, 2001);
+  hash.clear();
+  ASSERT_EQ(0, hash.size());
+}
+
+TEST(LockedHash, moveOnly) {
+  move_only<LockedHashChained>();
+  move_only<LockedHashSwiss>();
+  move_only<LockedHashCuckoo>();
+  move_only<LockedHashSplitOrdered>();
+}
+
+static size_t copies = 0;
+struct Counted {
+  string name;
+  Counted(const string &n) : name(n) {}
+  Counted(const Counted &o) : name(o.name) { copies++; }
+  Counted(Counted &&) = default;
+  Counted &operator=(const Counted &o) {
+    name = o.name;
+    copies++;
+    return *this;
+  }
+};
+struct CountedHash {
+  size_t operator()(Counted const &t) const noexcept {
+    return std::hash<string>{}(t.name);
+  }
+  size_t operator()(string const &s) const noexcept {
+    return std::hash<string>{}(s);
+  }
+};
+struct CountedMakeKey {
+  const string &operator()(Counted const &t) const noexcept { return t.name; }
+};
+
+TEST(LockedHash, insertMoves) {
+  LockedHash<string, Counted, CountedHash, CountedMakeKey> hash(16);
+  copies = 0;
+  // the value is moved in; the one copy is the returned value
+  ASSERT_EQ(hash(Counted("A"))->name, "A");
+  ASSERT_EQ(copies, 1);
+  copies = 0;
+  ASSERT_TRUE(hash.try_emplace("B", "B"));
+  ASSERT_TRUE(hash.emplace(string("C")));
+  ASSERT_EQ(copies, 0);
+  // an update runs on the value in the table, without a copy out
+  int seen = 0;
+  ASSERT_FALSE(hash("B", [&seen](Counted &) { seen++; }).has_value());
+  std::function<void(Counted &)> f = [&seen](Counted &) { seen++; };
+  ASSERT_FALSE(hash("C", f).has_value());
+  ASSERT_FALSE(hash("D", f).has_value());
+  ASSERT_EQ(seen, 2);
+  ASSERT_EQ(copies, 0);
+  ASSERT_EQ(3, hash.size());
+}
+
+template <typename _Storage> static void rm_moves() {
+  LockedHash<string, Counted, CountedHash, CountedMakeKey, _Storage> hash(16);
+  for (const char *n : {"A", "B", "C"}) {
+    hash.try_emplace(n, n);
+  }
+  copies = 0;
+  // the removed values are moved out of the table
+  ASSERT_EQ(hash.rm("A")->name, "A");
+  auto expired = hash.expire([](Counted &, time_t, void *) { return true; });
+  ASSERT_EQ(expired->size(), 2u);
+  ASSERT_EQ(copies, 0);
+  ASSERT_EQ(0, hash.size());
+}
+
+TEST(LockedHash, rmMoves) {
+  rm_moves<LockedHashChained>();
+  rm_moves<LockedHashSwiss>();
+  rm_moves<LockedHashCuckoo>();
+}
+
+template <typename _Storage> static void compute() {
+  typedef LockedHash<string, TestClass, TestClassHash, TestClassMakeKey,
+                     _Storage>
+      Hash;
+  typedef LockedHashEntry<TestClass> Entry;
+  Hash hash(16);
+  auto count = [](Entry &e) {
+    if (e) {
+      e->value++;
+    } else {
+      e.emplace("C").value = 1;
+    }
+  };
+  ASSERT_EQ(hash.compute("C", count), LockedHashOutcome::inserted);
+  ASSERT_EQ(hash.compute("C", count), LockedHashOutcome::updated);
+  ASSERT_EQ(hash("C")->value, 2);
+  ASSERT_EQ(hash.compute("D", [](Entry &) {}), LockedHashOutcome::absent);
+  ASSERT_EQ(1, hash.size());
+
+  // with a result
+  auto r = hash.compute("C", [](Entry &e) { return e->value * 10; });
+  ASSERT_EQ(r.first, LockedHashOutcome::updated);
+  ASSERT_EQ(r.second, 20);
+
+  // replace, then remove
+  hash.compute("C", [](Entry &e) { e.emplace("C").value = 7; });
+  ASSERT_EQ(hash("C")->value, 7);
+  ASSERT_EQ(hash.compute("C", [](Entry &e) { e.erase(); }),
+            LockedHashOutcome::removed);
+  ASSERT_EQ(0, hash.size());
+
+  TestClass m("M");
+  m.value = 3;
+  auto add = [](TestClass &cur, TestClass &t) { cur.value += t.value; };
+  ASSERT_EQ(hash.merge(m, add), LockedHashOutcome::inserted);
+  ASSERT_EQ(hash.merge(m, add), LockedHashOutcome::updated);
+  ASSERT_EQ(hash("M")->value, 6);
+
+  // no update is lost
+  vector<thread> vs;
+  for (int t = 0; t < 4; t++) {
+    vs.push_back(thread([&hash]() {
+      for (int j = 0; j < 2000; j++) {
+        string key = "K" + to_string(j % 50);
+        hash.compute(key, [&key](Entry &e) {
+          if (e) {
+            e->value++;
+          } else {
+            e.emplace(key).value = 1;
+          }
+        });
+      }
+    }));
+  }
+  for (auto &t : vs) {
+    t.join();
+  }
+  int total = 0;
+  hash.loop_shared([&total](size_t, time_t, const TestClass &t) {
+    total += t.name[0] == 'K' ? t.value : 0;
+  });
+  ASSERT_EQ(total, 4 * 2000);
+  ASSERT_EQ(51, hash.size());
+}
+
+TEST(LockedHash, compute) {
+  compute<LockedHashChained>();
+  compute<
+      LockedHashChainedPolicy<LockedHashIndexModulo, LockedHashEpochLock>>();
+  compute<LockedHashSwiss>();
+  compute<LockedHashCuckoo>();
+  compute<LockedHashSplitOrdered>();
+}
+
+template <typename _Storage> static void multi() {
+  typedef LockedHash<string, TestClass, TestClassHash, TestClassMakeKey,
+                     _Storage>
+      Hash;
+  Hash hash(16);
+  // more than one chunk of LOCKEDHASH_BATCH_KEYS
+  const size_t n = 600;
+  vector<TestClass> tps;
+  vector<string> keys;
+  for (size_t i = 0; i < n; i++) {
+    tps.emplace_back("B" + to_string(i));
+    tps.back().value = (int)i;
+    keys.push_back(tps.back().name);
+  }
+  unique_ptr<bool[]> ok(new bool[n + 1]);
+  ASSERT_EQ(hash.multi_insert(tps.data(), n, ok.get()), n);
+  ASSERT_TRUE(ok[0] && ok[n - 1]);
+  ASSERT_EQ(hash.multi_insert(tps.data(), 10), 0u);
+  ASSERT_EQ(n, hash.size());
+
+  keys.push_back("none");
+  vector<tl::optional<TestClass>> out(n + 1);
+  ASSERT_EQ(hash.multi_get(keys.data(), n + 1, out.data()), n);
+  for (size_t i = 0; i < n; i++) {
+    ASSERT_EQ(out[i]->value, (int)i);
+  }
+  ASSERT_FALSE(out[n].has_value());
+
+  auto add = [](size_t i, TestClass &t) { t.value += (int)i; };
+  ASSERT_EQ(hash.multi_update(keys.data(), n + 1, add, ok.get()), n);
+  ASSERT_TRUE(ok[5]);
+  ASSERT_FALSE(ok[n]);
+  ASSERT_EQ(hash("B7")->value, 14);
+
+  ASSERT_EQ(hash.multi_rm(keys.data(), n / 2, out.data()), n / 2);
+  ASSERT_EQ(out[3]->value, 6);
+  ASSERT_FALSE(hash("B3").has_value());
+  ASSERT_EQ(n - n / 2, hash.size());
+
+  // overlapping batches, in opposite key orders
+  vector<string> half(keys.begin() + n / 2, keys.begin() + n);
+  vector<string> reversed(half.rbegin(), half.rend());
+  vector<thread> vs;
+  for (int t = 0; t < 4; t++) {
+    vector<string> &batch = t % 2 ? reversed : half;
+    vs.push_back(thread([&hash, &batch]() {
+      for (int r = 0; r < 100; r++) {
+        hash.multi_update(batch.data(), batch.size(),
+                          [](size_t, TestClass &t) { t.value++; });
+      }
+    }));
+  }
+  for (auto &t : vs) {
+    t.join();
+  }
+  ASSERT_EQ(hash("B300")->value, 600 + 4 * 100);
+  ASSERT_EQ(hash("B599")->value, 1198 + 4 * 100);
+}
+
+TEST(LockedHash, multi) {
+  multi<LockedHashChained>();
+  multi<LockedHashChainedPolicy<LockedHashIndexModulo, LockedHashSharedLock>>();
+  multi<LockedHashChainedPolicy<LockedHashIndexModulo, LockedHashEpochLock>>();
+  multi<LockedHashSwiss>();
+  multi<LockedHashCuckoo>();
+  multi<LockedHashSplitOrdered>();
+
+  // lock-free reads take no stripe lock
+  SeqHash seq(8, 0, 4);
+  vector<size_t> ids;
+  for (size_t i = 0; i < 64; i++) {
+    seq(SeqValue{i, i, ~i});
+    ids.push_back(i * 2);
+  }
+  vector<tl::optional<SeqValue>> out(ids.size());
+  ASSERT_EQ(seq.multi_get(ids.data(), ids.size(), out.data()), 32u);
+  ASSERT_EQ(out[10]->a, 20u);
+}
+
+static size_t hash_calls = 0;
+struct CountingHash {
+  size_t operator()(const string &s) const noexcept {
+    hash_calls++;
+    return std::hash<string>{}(s);
+  }
+};
+
+template <typename _Storage> static void prehashed() {
+  typedef LockedHash<string, TestClass, TestClassHash, TestClassMakeKey,
+                     _Storage, std::equal_to<string>, CountingHash>
+      Hash;
+  Hash hash(16);
+  hash(TestClass("P1"));
+  typename Hash::hashed_key hk = hash.hashed("P1");
+  LockedHashHashedKey<string> hk2{"P2", CountingHash()("P2")};
+
+  hash_calls = 0;
+  ASSERT_TRUE(hash(hk).has_value());
+  ASSERT_FALSE(hash(hk2).has_value());
+  hash(hk, [](TestClass &t) { t.value = 1; });
+  int value = 0;
+  hash.find(hk, [&value](TestClass &t) { value = t.value; });
+  ASSERT_EQ(value, 1);
+  hash.find_shared(hk, [&value](const TestClass &t) { value = t.value + 1; });
+  ASSERT_EQ(value, 2);
+  ASSERT_EQ(*hash.apply(hk, [](TestClass &t) { return t.value; }), 1);
+  ASSERT_EQ(LockedHashOutcome::updated,
+            hash.compute(hk, [](LockedHashEntry<TestClass> &e) { //
+              e->value++;
+            }));
+  ASSERT_EQ(hash.alive(hk)->value, 2);
+  ASSERT_TRUE(hash.try_emplace(hk2, "P2"));
+  ASSERT_FALSE(hash.try_emplace(hk2, "P2"));
+  ASSERT_EQ(hash.rm(hk)->value, 2);
+  ASSERT_FALSE(hash.rm(hk).has_value());
+  ASSERT_EQ(hash_calls, 0u);
+
+  // the key overloads are unchanged
+  ASSERT_TRUE(hash("P2").has_value());
+  ASSERT_EQ(1, hash.size());
+}
+
+TEST(LockedHash, prehashed) {
+  prehashed<LockedHashChained>();
+  prehashed<
+      LockedHashChainedPolicy<LockedHashIndexModulo, LockedHashEpochLock>>();
+  prehashed<LockedHashSwiss>();
+  prehashed<LockedHashCuckoo>();
+  prehashed<LockedHashSplitOrdered>();
+
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey> hash(16);
+  hash(TestClass("A1"));
+  auto hk = hash.hashed("A1");
+  hash.access(hk)->value = 3;
+  ASSERT_EQ(hash.access_shared(hk)->value, 3);
+}
+
+/// few distinct hashes: equal fingerprints on one chain
+struct LengthHash {
+  size_t operator()(const string &s) const noexcept { return s.size(); }
+};
+
+template <typename _KeyHash> static void fingerprints() {
+  // one bucket: every key on one chain, longer than its 8 fingerprints
+  LockedHash<string, TestClass, TestClassHash, TestClassMakeKey,
+             LockedHashChained, std::equal_to<string>, _KeyHash>
+      hash(1);
+  hash.max_load_factor(0);
+  vector<string> keys;
+  for (int i = 0; i < 20; i++) {
+    keys.push_back("F" + to_string(i * 7));
+    hash(TestClass(keys.back()));
+  }
+  ASSERT_EQ(1, hash.bucket_count());
+
+  mt19937 rng(7);
+  shuffle(keys.begin(), keys.end(), rng);
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_TRUE(hash.rm(keys[i]).has_value());
+    for (size_t j = 0; j < keys.size(); j++) {
+      ASSERT_EQ(hash(keys[j]).has_value(), j > i) << keys[j];
+    }
+    ASSERT_FALSE(hash("F1").has_value());
+  }
+  ASSERT_EQ(0, hash.size());
+}
+
+TEST(LockedHash, fingerprints) {
+  fingerprints<TestClassHash>();
+  fingerprints<LengthHash>();
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
-}
\ No newline at end of file
+}
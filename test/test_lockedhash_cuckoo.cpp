@@ -0,0 +1,111 @@
+#include "lockedhash.hpp"
+#include "test_lockedhash_fixture.hpp"
+#include "gtest/gtest.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+using CuckooHash = TestHash<LockedHashCuckoo>;
+
+TEST(LockedHash_cuckoo, lockStripes) {
+  CuckooHash sized(5000);
+  ASSERT_EQ(8, sized.lock_stripes());
+  CuckooHash hash(1000, 0, 3);
+  ASSERT_EQ(4, hash.lock_stripes());
+  ASSERT_EQ(4, hash.bucket_count());
+  test_insert(&hash, 0, 5000);
+  ASSERT_EQ(5000, hash.size());
+  ASSERT_EQ(hash("k_4999")->name, "k_4999");
+}
+
+TEST(LockedHash_cuckoo, occupancy) {
+  // one shard of 1024 slots (256 buckets)
+  CuckooHash hash(1024, 0, 1);
+  test_insert(&hash, 0, 1);
+  ASSERT_EQ(1024, hash.capacity());
+  test_insert(&hash, 1, 949);
+  ASSERT_EQ(1024, hash.capacity());
+  ASSERT_GE(hash.load_factor(), 0.9);
+  for (size_t i = 0; i < 950; i++) {
+    ASSERT_EQ(hash("k_" + to_string(i)).has_value(), true);
+  }
+
+  // grows once no displacement chain is left, and keeps every entry
+  test_insert(&hash, 950, 4000);
+  ASSERT_GT(hash.capacity(), 1024);
+  ASSERT_EQ(4950, hash.size());
+  for (size_t i = 0; i < 4950; i++) {
+    ASSERT_EQ(hash("k_" + to_string(i)).has_value(), true);
+  }
+}
+
+/// every key collides: more keys than the 8 slots of one bucket pair
+struct CollidingHash {
+  size_t operator()(TestClass const &) const noexcept { return 42; }
+};
+
+TEST(LockedHash_cuckoo, collidingHashes) {
+  LockedHash<string, TestClass, CollidingHash, TestClassMakeKey,
+             LockedHashCuckoo>
+      hash(64, 0, 1);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(hash(TestClass("C" + to_string(i))).has_value()) << i;
+  }
+  ASSERT_EQ(100, hash.size());
+  // the buckets grow with the entries (stashed), not without bound
+  ASSERT_LT(hash.capacity(), 1024);
+  for (int i = 0; i < 100; i += 2) {
+    ASSERT_TRUE(hash.rm("C" + to_string(i)).has_value());
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(hash("C" + to_string(i)).has_value(), i % 2 == 1) << i;
+  }
+  size_t seen = 0;
+  hash.loop_shared([&seen](size_t, time_t, const TestClass &) { seen++; });
+  ASSERT_EQ(50, seen);
+  hash.clear();
+  ASSERT_EQ(0, hash.size());
+  ASSERT_TRUE(hash(TestClass("C1")).has_value());
+}
+
+TEST(LockedHash_cuckoo, recursiveLock) {
+  CuckooHash hash(3);
+  hash(TestClass("A1"));
+  if (auto a = hash.access("A1")) {
+    a->value = 1;
+    // shard locks are recursive
+    ASSERT_EQ(hash("A1")->value, 1);
+  } else {
+    FAIL();
+  }
+}
+
+TEST(LockedHash_cuckoo, fullInCallback) {
+  CuckooHash hash(16, 0, 1);
+  hash(TestClass("A"));
+  size_t capacity = hash.capacity();
+  size_t inserted = 1;
+  string dropped;
+  hash.find("A", [&](TestClass &) {
+    // the shard can not grow under find: inserts stop once it is full
+    for (size_t i = 0; i < capacity * 2 && dropped.empty(); i++) {
+      string key = "k_" + to_string(i);
+      LockedHashOutcome o = hash.compute(
+          key, [&key](LockedHashEntry<TestClass> &e) { e.emplace(key); });
+      if (o == LockedHashOutcome::full) {
+        dropped = key;
+      } else {
+        ASSERT_EQ(o, LockedHashOutcome::inserted);
+        inserted++;
+      }
+    }
+    ASSERT_FALSE(hash(TestClass(dropped)).has_value());
+  });
+  ASSERT_FALSE(dropped.empty());
+  ASSERT_EQ(inserted, hash.size());
+  ASSERT_FALSE(hash(dropped).has_value());
+  // outside the callback the shard makes room
+  ASSERT_EQ(hash(TestClass(dropped))->name, dropped);
+}
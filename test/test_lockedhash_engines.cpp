@@ -0,0 +1,160 @@
+#include "lockedhash.hpp"
+#include "test_lockedhash_fixture.hpp"
+#include "gtest/gtest.h"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+template <typename _Engine>
+class LockedHashEngineTest : public ::testing::Test {};
+typedef ::testing::Types<LockedHashChained, LockedHashSwiss, LockedHashCuckoo,
+                         LockedHashSplitOrdered>
+    Engines;
+TYPED_TEST_CASE(LockedHashEngineTest, Engines);
+
+TYPED_TEST(LockedHashEngineTest, insertSearch) {
+  TestHash<TypeParam> hash(3);
+  for (int i = 0; i < 1000; i++) {
+    hash(TestClass("A" + to_string(i)));
+  }
+  ASSERT_EQ(1000, hash.size());
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(hash["A" + to_string(i)]->name, "A" + to_string(i));
+  }
+  ASSERT_EQ(hash["A5555"].has_value(), false);
+
+  // duplicate insert is not an insert
+  ASSERT_EQ(hash(TestClass("A5")).has_value(), false);
+  ASSERT_EQ(1000, hash.size());
+
+  size_t tot = 0;
+  for (auto &v : hash.bucket_elements()) {
+    tot += v;
+  }
+  ASSERT_EQ(tot, hash.size());
+}
+
+TYPED_TEST(LockedHashEngineTest, removeReinsert) {
+  TestHash<TypeParam> hash(3);
+  for (int round = 0; round < 5; round++) {
+    for (int i = 0; i < 500; i++) {
+      hash(TestClass("A" + to_string(i)));
+    }
+    ASSERT_EQ(500, hash.size());
+    for (int i = 0; i < 500; i += 2) {
+      ASSERT_EQ(hash.rm("A" + to_string(i))->name, "A" + to_string(i));
+    }
+    ASSERT_EQ(250, hash.size());
+    for (int i = 1; i < 500; i += 2) {
+      ASSERT_EQ(hash("A" + to_string(i)).has_value(), true);
+    }
+    for (int i = 0; i < 500; i += 2) {
+      ASSERT_EQ(hash("A" + to_string(i)).has_value(), false);
+    }
+    hash.clear();
+    ASSERT_EQ(0, hash.size());
+  }
+
+  hash(TestClass("K"));
+  ASSERT_EQ(hash.rm("K", [](TestClass &) { return false; }).has_value(),
+            false);
+  ASSERT_EQ(hash("K").has_value(), true);
+}
+
+TYPED_TEST(LockedHashEngineTest, updateLoopExpire) {
+  TestHash<TypeParam> hash(100, 60);
+  for (int i = 0; i < 20; i++) {
+    hash(TestClass("A" + to_string(i)));
+  }
+  hash("A1", [](TestClass &t) { t.value = 500; });
+  ASSERT_EQ(hash["A1"]->value, 500);
+  hash.find("A2", [](TestClass &t) { t.value = 600; });
+  ASSERT_EQ(hash["A2"]->value, 600);
+  ASSERT_EQ(hash.alive("A2")->value, 600);
+
+  size_t tot = 0;
+  hash.loop([&tot](size_t bucket, time_t timestamp, TestClass &t) {
+    (void)bucket;
+    (void)timestamp;
+    (void)t;
+    tot += 1;
+    return false;
+  });
+  ASSERT_EQ(tot, hash.size());
+
+  hash.loop_with_delete([](size_t bucket, time_t timestamp, TestClass &t) {
+    (void)bucket;
+    (void)timestamp;
+    return t.value == 0;
+  });
+  ASSERT_EQ(2, hash.size());
+
+  ASSERT_EQ(hash.expire().has_value(), false);
+  auto expired = hash.expire([](TestClass &t, time_t timestamp, void *arg) {
+    (void)timestamp;
+    (void)arg;
+    return t.value == 500;
+  });
+  ASSERT_EQ(expired->size(), 1);
+  ASSERT_EQ(expired->front().name, "A1");
+  ASSERT_EQ(1, hash.size());
+}
+
+TYPED_TEST(LockedHashEngineTest, threadSafe) {
+  TestHash<TypeParam> hash(16);
+  vector<thread> vs;
+  for (size_t i = 1; i <= 16; i++) {
+    vs.push_back(
+        thread(test_insert<TestHash<TypeParam>>, &hash, i * 1000, 1000));
+  }
+  for (auto &t : vs) {
+    t.join();
+  }
+  ASSERT_EQ(16000, hash.size());
+  for (size_t i = 1000; i < 17000; i++) {
+    ASSERT_EQ(hash("k_" + to_string(i)).has_value(), true);
+  }
+}
+
+/// engines that change values in place under their locks (access)
+template <typename _Engine>
+class LockedHashInPlaceTest : public ::testing::Test {};
+typedef ::testing::Types<LockedHashChained, LockedHashSwiss, LockedHashCuckoo>
+    InPlaceEngines;
+TYPED_TEST_CASE(LockedHashInPlaceTest, InPlaceEngines);
+
+TYPED_TEST(LockedHashInPlaceTest, accessor) {
+  TestHash<TypeParam> hash(3);
+  for (int i = 0; i < 100; i++) {
+    hash(TestClass("A" + to_string(i)));
+  }
+  if (auto a = hash.access("A1")) {
+    a->value = 1;
+  } else {
+    FAIL();
+  }
+  ASSERT_FALSE(hash.access("A5555"));
+  ASSERT_EQ(hash.access_shared("A1")->value, 1);
+  ASSERT_EQ(*hash.apply("A1", [](TestClass &t) { return ++t.value; }), 2);
+  ASSERT_FALSE(hash.apply_shared("A5555", [](const TestClass &t) { //
+    return t.value;
+  }));
+
+  vector<thread> vs;
+  for (int t = 0; t < 4; t++) {
+    vs.push_back(thread([&hash]() {
+      for (int j = 0; j < 1000; j++) {
+        if (auto a = hash.access("A" + to_string(j % 10))) {
+          a->value++;
+        }
+      }
+    }));
+  }
+  for (auto &t : vs) {
+    t.join();
+  }
+  ASSERT_EQ(hash("A0")->value, 400);
+}
@@ -0,0 +1,49 @@
+#ifndef __TEST_LOCKED_HASH_FIXTURE_HPP__
+#define __TEST_LOCKED_HASH_FIXTURE_HPP__
+
+#include "lockedhash.hpp"
+#include <functional>
+#include <memory>
+#include <stddef.h>
+#include <string>
+
+/**
+ * @brief value of the unit tests, keyed by its name
+ */
+class TestClass {
+public:
+  std::string name = "";
+  int value = 0;
+  TestClass() {}
+  TestClass(const std::string &n) : TestClass() { name = n; }
+};
+
+struct TestClassHash {
+  size_t operator()(TestClass const &t) const noexcept {
+    return std::hash<std::string>{}(t.name);
+  }
+};
+struct TestClassMakeKey {
+  std::string operator()(TestClass const &t) const noexcept { //
+    return t.name;
+  }
+};
+
+/// TestClass table on storage _Storage
+template <typename _Storage = LockedHashChained,
+          typename _Alloc = std::allocator<TestClass>>
+using TestHash =
+    LockedHash<std::string, TestClass, TestClassHash, TestClassMakeKey,
+               _Storage, std::equal_to<std::string>, TestClassHash, _Alloc>;
+
+/// insert "k_<start>" ~ "k_<start + amount - 1>"
+template <typename _Hash>
+void test_insert(_Hash *hash, size_t start, size_t amount) {
+  for (size_t i = start; i < start + amount; i++) {
+    TestClass t;
+    t.name = "k_" + std::to_string(i);
+    (*hash)(t);
+  }
+}
+
+#endif
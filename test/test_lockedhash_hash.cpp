@@ -0,0 +1,177 @@
+#include "lockedhash.hpp"
+#include "gtest/gtest.h"
+#include <random>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+/// fixed-width key without padding
+struct FlowKey {
+  uint32_t src, dst;
+  uint16_t sport, dport;
+  uint32_t proto;
+
+  bool operator==(const FlowKey &o) const {
+    return src == o.src && dst == o.dst && sport == o.sport &&
+           dport == o.dport && proto == o.proto;
+  }
+};
+
+class FlowClass {
+public:
+  FlowKey key;
+  int packets = 0;
+};
+
+struct FlowClassMakeKey {
+  const FlowKey &operator()(FlowClass const &f) const noexcept {
+    return f.key;
+  }
+};
+
+template <typename _H, typename _K> static void batchIsScalar(_H h) {
+  mt19937_64 rng(3);
+  // not a multiple of 4: the scalar tail too
+  vector<_K> keys(103);
+  for (auto &k : keys) {
+    k = (_K)rng();
+  }
+  vector<size_t> out(keys.size());
+  h.batch(keys.data(), keys.size(), out.data());
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_EQ(out[i], h(keys[i])) << i;
+  }
+}
+
+TEST(LockedHash_hash, intBatch) {
+  batchIsScalar<LockedHashIntHash, uint64_t>(LockedHashIntHash());
+  batchIsScalar<LockedHashIntHash, int64_t>(LockedHashIntHash());
+  batchIsScalar<LockedHashIntHash, uint32_t>(LockedHashIntHash());
+  batchIsScalar<LockedHashIntHash, int32_t>(LockedHashIntHash());
+  batchIsScalar<LockedHashIntHash, uint16_t>(LockedHashIntHash());
+  // sign extended, as (uint64_t)key
+  ASSERT_EQ(LockedHashIntHash()((int32_t)-1), LockedHashIntHash()((int64_t)-1));
+  ASSERT_NE(LockedHashIntHash()(1), LockedHashIntHash()(2));
+}
+
+TEST(LockedHash_hash, bytesBatch) {
+  mt19937_64 rng(5);
+  vector<FlowKey> keys(37);
+  for (auto &k : keys) {
+    k = FlowKey{(uint32_t)rng(), (uint32_t)rng(), (uint16_t)rng(),
+                (uint16_t)rng(), (uint32_t)rng()};
+  }
+  vector<size_t> out(keys.size());
+  LockedHashBytesHash h;
+  h.batch(keys.data(), keys.size(), out.data());
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_EQ(out[i], h(keys[i])) << i;
+  }
+  FlowKey a = keys[0];
+  FlowKey b = a;
+  b.dport++;
+  ASSERT_EQ(h(a), h(keys[0]));
+  ASSERT_NE(h(a), h(b));
+}
+
+TEST(LockedHash_hash, multi) {
+  LockedHash<FlowKey, FlowClass, LockedHashBytesHash, FlowClassMakeKey,
+             LockedHashSwiss>
+      hash(64);
+  vector<FlowClass> flows(300);
+  vector<FlowKey> keys;
+  for (uint32_t i = 0; i < flows.size(); i++) {
+    flows[i].key = FlowKey{i, i * 3, 80, (uint16_t)i, 6};
+    flows[i].packets = (int)i;
+    keys.push_back(flows[i].key);
+  }
+  ASSERT_EQ(hash.multi_insert(flows.data(), flows.size()), flows.size());
+  vector<tl::optional<FlowClass>> out(keys.size());
+  ASSERT_EQ(hash.multi_get(keys.data(), keys.size(), out.data()),
+            keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_EQ(out[i]->packets, (int)i);
+  }
+  ASSERT_EQ(hash(keys[7])->packets, 7);
+}
+
+TEST(LockedHash_hash, stringHash) {
+  LockedHashStringHash h;
+  // every length branch: empty, 1-3, 4-16, 17-48, more than 48
+  set<size_t> seen;
+  string s;
+  for (int len = 0; len < 200; len++) {
+    ASSERT_TRUE(seen.insert(h(s)).second) << len;
+    ASSERT_EQ(h(s), h(s.c_str()));
+    if (len > 0) {
+      // the last byte counts
+      string t = s;
+      t[len - 1] = 'Y';
+      ASSERT_NE(h(s), h(t)) << len;
+    }
+    s.push_back((char)('a' + len % 26));
+  }
+  ASSERT_NE(h(string("\0", 1)), h(string("\0\0", 2)));
+}
+
+TEST(LockedHash_hash, tupleHash) {
+  LockedHashTupleHash h;
+  ASSERT_NE(h(make_pair(1, 2)), h(make_pair(2, 1)));
+  ASSERT_NE(h(make_pair(string("a"), 1)), h(make_pair(string("a"), 2)));
+  ASSERT_EQ(h(make_tuple(string("a"), 1, 2.5)),
+            h(make_tuple(string("a"), 1, 2.5)));
+  ASSERT_NE(h(make_tuple(1, 2, 3)), h(make_tuple(1, 3, 2)));
+  ASSERT_NE(h(make_pair(make_pair(1, 2), 3)), h(make_pair(make_pair(1, 3), 2)));
+
+  // sequential ids of one name spread over 1024 buckets
+  set<size_t> buckets;
+  for (int i = 0; i < 1024; i++) {
+    buckets.insert(h(make_pair(string("kim"), i)) % 1024);
+  }
+  ASSERT_GT(buckets.size(), 600u);
+}
+
+/// a weak hash: the id only, shifted out of the low bits
+struct WeakHash {
+  size_t operator()(uint64_t id) const noexcept { return id << 12; }
+};
+struct FlowClassMakeId {
+  uint64_t operator()(FlowClass const &f) const noexcept {
+    return (uint64_t)f.packets;
+  }
+};
+
+TEST(LockedHash_hash, mixed) {
+  typedef LockedHash<uint64_t, FlowClass, LockedHashMixed<WeakHash>,
+                     FlowClassMakeId>
+      Hash;
+  ASSERT_EQ(LockedHashMixed<WeakHash>()(7), LockedHashFmix::mix(7 << 12));
+  // batch() only where _Hash has one
+  ASSERT_FALSE((LockedHashIsBatchHash<LockedHashMixed<WeakHash>,
+                                      uint64_t>::value));
+  ASSERT_TRUE((LockedHashIsBatchHash<LockedHashMixed<LockedHashIntHash>,
+                                     uint64_t>::value));
+  uint64_t ids[5] = {1, 2, 3, 4, 5};
+  size_t out[5];
+  LockedHashMixed<LockedHashIntHash>().batch(ids, 5, out);
+  ASSERT_EQ(out[4], LockedHashFmix::mix(LockedHashIntHash()(5)));
+
+  // without the finalizer every id lands in bucket 0 of 1024
+  Hash hash(1024);
+  hash.max_load_factor(0);
+  for (int i = 0; i < 1024; i++) {
+    FlowClass f;
+    f.packets = i;
+    hash(f);
+  }
+  size_t longest = 0;
+  hash.showbucket([&longest](size_t, size_t cnt) { //
+    longest = max(longest, cnt);
+  });
+  ASSERT_LT(longest, 16u);
+  ASSERT_EQ(hash(5)->packets, 5);
+}
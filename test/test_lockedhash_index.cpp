@@ -0,0 +1,113 @@
+#include "lockedhash.hpp"
+#include "gtest/gtest.h"
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class IndexClass {
+public:
+  size_t id = 0;
+  IndexClass() {}
+  IndexClass(size_t i) : IndexClass() { id = i; }
+};
+
+/// identity hash: the weak case for mask and fastrange
+struct IndexClassHash {
+  size_t operator()(IndexClass const &t) const noexcept { return t.id; }
+  size_t operator()(size_t id) const noexcept { return id; }
+};
+struct IndexClassMakeKey {
+  size_t operator()(IndexClass const &t) const noexcept { return t.id; }
+};
+
+template <typename _Index>
+using IndexHash =
+    LockedHash<size_t, IndexClass, IndexClassHash, IndexClassMakeKey,
+               LockedHashChainedPolicy<_Index>>;
+
+TEST(LockedHash_index, reciprocalIsModulo) {
+  mt19937_64 rng(7);
+  vector<size_t> sizes = {1, 2, 3, 7, 10, 1000, 1UL << 20, 1000003,
+                          (1UL << 63) + 5};
+  for (size_t n : sizes) {
+    LockedHashIndexReciprocal rcp;
+    ASSERT_EQ(rcp.init(n), n);
+    vector<size_t> hashes = {0, 1, n - 1, n, n + 1, UINT64_MAX,
+                             UINT64_MAX - 1};
+    for (int i = 0; i < 10000; i++) {
+      hashes.push_back(rng());
+    }
+    for (size_t h : hashes) {
+      size_t home, high;
+      rcp(h, home, high);
+      ASSERT_EQ(home, h % n) << h << " % " << n;
+      ASSERT_EQ(high, h / n) << h << " / " << n;
+    }
+  }
+}
+
+TEST(LockedHash_index, maskRoundsUp) {
+  LockedHashIndexMask mask;
+  ASSERT_EQ(mask.init(1), 1);
+  ASSERT_EQ(mask.init(100), 128);
+  ASSERT_EQ(mask.init(128), 128);
+
+  // identity hashes of a stride still spread over all buckets
+  vector<size_t> used(128, 0);
+  for (size_t i = 0; i < 128 * 16; i++) {
+    size_t home, high;
+    mask(i * 128, home, high);
+    used[home]++;
+  }
+  for (size_t u : used) {
+    ASSERT_GT(u, 0);
+  }
+}
+
+template <typename _Index> class LockedHashIndexTest : public ::testing::Test {};
+typedef ::testing::Types<LockedHashIndexModulo, LockedHashIndexMask,
+                         LockedHashIndexFastrange, LockedHashIndexReciprocal>
+    IndexPolicies;
+TYPED_TEST_CASE(LockedHashIndexTest, IndexPolicies);
+
+TYPED_TEST(LockedHashIndexTest, insertGrowShrink) {
+  IndexHash<TypeParam> hash(10);
+  size_t bucket_size = hash.bucket_count();
+  vector<thread> threads;
+  for (size_t t = 0; t < 4; t++) {
+    threads.push_back(thread([&hash, t]() {
+      for (size_t i = t * 5000; i < (t + 1) * 5000; i++) {
+        // spread identity hashes over the whole 64-bit range too
+        hash(IndexClass(i * 0x9e3779b97f4a7c15ULL));
+      }
+    }));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(20000, hash.size());
+  ASSERT_GT(hash.bucket_count(), bucket_size);
+
+  for (size_t i = 0; i < 20000; i++) {
+    ASSERT_EQ(hash(i * 0x9e3779b97f4a7c15ULL)->id, i * 0x9e3779b97f4a7c15ULL);
+  }
+  ASSERT_EQ(hash((size_t)1).has_value(), false);
+
+  for (size_t i = 0; i < 19990; i++) {
+    ASSERT_EQ(hash.rm(i * 0x9e3779b97f4a7c15ULL).has_value(), true);
+  }
+  while (hash.rehash_step(100)) {
+  }
+  ASSERT_EQ(10, hash.size());
+  ASSERT_LE(hash.bucket_count(), 10 / hash.min_load_factor() + 1);
+  size_t seen = 0;
+  hash.loop([&seen](size_t, time_t, IndexClass &) {
+    seen++;
+    return false;
+  });
+  ASSERT_EQ(seen, 10);
+}
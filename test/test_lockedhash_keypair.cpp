@@ -40,6 +40,25 @@ struct PersonMakeKey {
   }
 };
 
+static size_t person_constructed = 0;
+class CountedPerson : public Person {
+public:
+  CountedPerson() {}
+  CountedPerson(const PersonKey &k) : Person(k) { person_constructed++; }
+  CountedPerson(const string &name, int empno) : Person(name, empno) {}
+};
+
+struct CountedPersonHash {
+  size_t operator()(CountedPerson const &p) const noexcept {
+    return std::hash<string>{}(p.name()) + p.empno();
+  }
+};
+struct PersonKeyHash {
+  size_t operator()(PersonKey const &k) const noexcept {
+    return std::hash<string>{}(k.first) + k.second;
+  }
+};
+
 TEST(LockedHash_pairkey, insertRvalue_pairkey) {
   LockedHash<PersonKey, Person, PersonHash, PersonMakeKey> hash(3);
   for (int i = 1; i <= 10; i++) {
@@ -62,3 +81,19 @@ TEST(LockedHash_pairkey, insertLvalue_pairkey) {
   ASSERT_EQ(hash(PersonKey("P#3", 103))->name(), "P#3");
   ASSERT_EQ(10, hash.size());
 }
+
+TEST(LockedHash_pairkey, keyHash_pairkey) {
+  LockedHash<PersonKey, CountedPerson, CountedPersonHash, PersonMakeKey,
+             LockedHashChained, std::equal_to<PersonKey>, PersonKeyHash>
+      hash(3);
+  for (int i = 1; i <= 10; i++) {
+    hash(CountedPerson("P#" + to_string(i), 100 + i));
+  }
+
+  person_constructed = 0;
+  ASSERT_EQ(hash(PersonKey("P#3", 103))->name(), "P#3");
+  ASSERT_EQ(hash(PersonKey("P#3", 104)).has_value(), false);
+  ASSERT_EQ(hash.rm(PersonKey("P#4", 104)).has_value(), true);
+  ASSERT_EQ(person_constructed, 0);
+  ASSERT_EQ(9, hash.size());
+}
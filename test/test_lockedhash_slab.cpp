@@ -0,0 +1,168 @@
+#include "lockedhash.hpp"
+#include "test_lockedhash_fixture.hpp"
+#include "gtest/gtest.h"
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+using SlabHash =
+    TestHash<LockedHashChained, LockedHashSlabAllocator<TestClass>>;
+
+TEST(LockedHash_slab, poolReuse) {
+  LockedHashSlabPool pool(40);
+  ASSERT_EQ(pool.object_size() % alignof(max_align_t), 0);
+  ASSERT_EQ(pool.slab_count(), 0);
+
+  size_t per_slab = LOCKEDHASH_SLAB_SIZE / pool.object_size();
+  vector<void *> v;
+  set<void *> unique;
+  for (size_t i = 0; i < per_slab + 1; i++) {
+    v.push_back(pool.allocate());
+    unique.insert(v.back());
+  }
+  ASSERT_EQ(unique.size(), v.size());
+  ASSERT_EQ(pool.slab_count(), 2);
+
+  for (void *p : v) {
+    pool.deallocate(p);
+  }
+  for (size_t i = 0; i < per_slab + 1; i++) {
+    pool.allocate();
+  }
+  // freed objects are reused before a new slab is taken
+  ASSERT_EQ(pool.slab_count(), 2);
+}
+
+TEST(LockedHash_slab, poolBulkFree) {
+  LockedHashSlabPool pool(24);
+  vector<void *> v;
+  for (int i = 0; i < 1000; i++) {
+    v.push_back(pool.allocate());
+  }
+  size_t slabs = pool.slab_count();
+  pool.deallocate_bulk(v.data(), v.size());
+  for (int i = 0; i < 1000; i++) {
+    pool.allocate();
+  }
+  ASSERT_EQ(pool.slab_count(), slabs);
+}
+
+TEST(LockedHash_slab, rebindSharesPools) {
+  LockedHashSlabAllocator<TestClass> a;
+  LockedHashSlabAllocator<int> b(a);
+  LockedHashSlabAllocator<TestClass> c(b);
+  ASSERT_TRUE(a == b);
+  ASSERT_TRUE(LockedHashSlabAllocator<TestClass>(b) == a);
+  ASSERT_TRUE(a != LockedHashSlabAllocator<TestClass>());
+  ASSERT_FALSE(a.unique());
+
+  // a rebound copy frees what another allocated
+  TestClass *p = a.allocate(1);
+  c.deallocate(p, 1);
+  ASSERT_EQ(a.allocate(1), p);
+  ASSERT_EQ(a.slab_count(), 1);
+  ASSERT_EQ(b.slab_count(), 0);
+}
+
+TEST(LockedHash_slab, sharedAllocator) {
+  // the table does not hold the last copy: its nodes go back to the pool
+  LockedHashSlabAllocator<TestClass> a;
+  size_t slabs;
+  {
+    SlabHash hash(11, 0, 0, a);
+    test_insert(&hash, 0, 5000);
+    slabs = hash.get_allocator().slab_count();
+  }
+  SlabHash hash(11, 0, 0, a);
+  test_insert(&hash, 0, 5000);
+  ASSERT_EQ(hash.get_allocator().slab_count(), slabs);
+}
+
+/// objects alive in any BulkAllocator
+static int bulk_live = 0;
+
+/// std::allocator with deallocate_bulk, counting live objects
+template <typename _T> struct BulkAllocator {
+  typedef _T value_type;
+  BulkAllocator() {}
+  template <typename _U> BulkAllocator(const BulkAllocator<_U> &) {}
+  _T *allocate(size_t n) {
+    bulk_live += n;
+    return std::allocator<_T>().allocate(n);
+  }
+  void deallocate(_T *p, size_t n) {
+    bulk_live -= n;
+    std::allocator<_T>().deallocate(p, n);
+  }
+  void deallocate_bulk(_T *const *ptrs, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      deallocate(ptrs[i], 1);
+    }
+  }
+  template <typename _U> bool operator==(const BulkAllocator<_U> &) const {
+    return true;
+  }
+  template <typename _U> bool operator!=(const BulkAllocator<_U> &) const {
+    return false;
+  }
+};
+
+TEST(LockedHash_slab, bulkAllocatorFreed) {
+  using BulkHash = TestHash<LockedHashChained, BulkAllocator<TestClass>>;
+  {
+    BulkHash hash(11);
+    for (int i = 0; i < 1000; i++) {
+      hash(TestClass("k_" + to_string(i)));
+    }
+    hash.rm("k_1");
+  }
+  // deallocate_bulk alone does not free on destruction: every node goes
+  ASSERT_EQ(bulk_live, 0);
+}
+
+TEST(LockedHash_slab, insertClear) {
+  SlabHash hash(11);
+  ASSERT_EQ(hash.get_allocator().slab_count(), 0);
+  test_insert(&hash, 0, 5000);
+  ASSERT_EQ(5000, hash.size());
+  ASSERT_EQ(hash("k_77")->name, "k_77");
+  ASSERT_EQ(hash.rm("k_78")->name, "k_78");
+  ASSERT_EQ(hash("k_78").has_value(), false);
+
+  size_t slabs = hash.get_allocator().slab_count();
+  ASSERT_GT(slabs, 0);
+  hash.clear();
+  ASSERT_EQ(0, hash.size());
+  test_insert(&hash, 0, 5000);
+  ASSERT_EQ(5000, hash.size());
+  ASSERT_EQ(hash.get_allocator().slab_count(), slabs);
+
+  hash.loop_with_delete(
+      [](size_t, time_t, TestClass &t) { return t.name < "k_3"; });
+  ASSERT_EQ(hash("k_2999").has_value(), false);
+  ASSERT_EQ(hash("k_3000")->name, "k_3000");
+}
+
+TEST(LockedHash_slab, threadSafe) {
+  SlabHash hash(7);
+  vector<thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.push_back(thread([&hash, i]() {
+      test_insert(&hash, i * 2000, 2000);
+      for (int j = 0; j < 1000; j++) {
+        hash.rm("k_" + to_string(i * 2000 + j));
+      }
+    }));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(4000, hash.size());
+  ASSERT_EQ(hash("k_1999")->name, "k_1999");
+  ASSERT_EQ(hash("k_2000").has_value(), false);
+}
@@ -0,0 +1,124 @@
+#include "lockedhash.hpp"
+#include "test_lockedhash_fixture.hpp"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+using SOHash = TestHash<LockedHashSplitOrdered>;
+
+TEST(LockedHash_splitordered, growInPlace) {
+  SOHash hash(3);
+  ASSERT_EQ(4, hash.bucket_count());
+  test_insert(&hash, 0, 1000);
+  ASSERT_EQ(1000, hash.size());
+  // grows without moving entries
+  ASSERT_GE(hash.bucket_count(), 1000 / hash.max_load_factor());
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(hash["k_" + to_string(i)]->name, "k_" + to_string(i));
+  }
+}
+
+TEST(LockedHash_splitordered, concurrentUpdateRemove) {
+  SOHash hash(4);
+  for (int i = 0; i < 64; i++) {
+    hash(TestClass("A" + to_string(i)));
+  }
+  std::atomic<bool> done(false);
+  std::atomic<size_t> torn(0);
+  vector<thread> vs;
+  for (int r = 0; r < 2; r++) {
+    vs.push_back(thread([&]() {
+      while (!done) {
+        for (int i = 0; i < 64; i++) {
+          hash.find_shared("A" + to_string(i), [&](const TestClass &t) {
+            torn += t.name != "A" + to_string(i);
+          });
+        }
+      }
+    }));
+  }
+  // writers: updates racing removes, and inserts growing the table
+  vector<thread> ws;
+  for (int w = 0; w < 2; w++) {
+    ws.push_back(thread([&hash, w]() {
+      for (int n = 0; n < 2000; n++) {
+        string key = "A" + to_string(n % 64);
+        hash(key, [](TestClass &t) { t.value++; });
+        if (n % 7 == w) {
+          hash.rm(key);
+          hash(TestClass(key));
+        }
+        hash(TestClass("B" + to_string(w * 2000 + n)));
+      }
+    }));
+  }
+  for (auto &t : ws) {
+    t.join();
+  }
+  done = true;
+  for (auto &t : vs) {
+    t.join();
+  }
+  ASSERT_EQ(torn.load(), 0);
+  ASSERT_EQ(64 + 4000, hash.size());
+  size_t tot = 0;
+  hash.loop_shared([&tot](size_t, time_t, const TestClass &) { tot++; });
+  ASSERT_EQ(tot, hash.size());
+}
+
+TEST(LockedHash_splitordered, accessShared) {
+  SOHash hash(4);
+  hash(TestClass("A1"));
+  hash.find("A1", [](TestClass &t) { t.value = 1; });
+
+  auto a = hash.access_shared("A1");
+  ASSERT_TRUE(a);
+  // the snapshot stays valid while the value is replaced and removed
+  hash.find("A1", [](TestClass &t) { t.value = 2; });
+  hash.rm("A1");
+  ASSERT_EQ(a->value, 1);
+  a.release();
+
+  ASSERT_FALSE(hash.access_shared("A1"));
+  hash(TestClass("A2"));
+  ASSERT_EQ(*hash.apply("A2", [](TestClass &t) { return t.value = 3; }), 3);
+  ASSERT_EQ(*hash.apply_shared("A2", [](const TestClass &t) { //
+    return t.value;
+  }),
+            3);
+}
+
+TEST(LockedHash_splitordered, manyThreads) {
+  SOHash hash(16);
+  test_insert(&hash, 0, 10);
+  // more live threads than one block of epoch slots (each keeps its slot)
+  const int threads = LOCKEDHASH_EPOCH_THREADS + 44;
+  atomic<int> done(0);
+  atomic<bool> stop(false);
+  vector<thread> vs;
+  for (int t = 0; t < threads; t++) {
+    vs.push_back(thread([&hash, &done, &stop, t]() {
+      if (hash("k_" + to_string(t % 10)).has_value()) {
+        done++;
+      }
+      while (!stop) {
+        this_thread::yield();
+      }
+    }));
+  }
+  for (int i = 0; i < 3000 && done < threads; i++) {
+    usleep(1000);
+  }
+  int finished = done;
+  stop = true;
+  for (auto &t : vs) {
+    t.join();
+  }
+  ASSERT_EQ(finished, threads);
+}
@@ -0,0 +1,62 @@
+#include "lockedhash.hpp"
+#include "test_lockedhash_fixture.hpp"
+#include "gtest/gtest.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+using SwissHash = TestHash<LockedHashSwiss>;
+
+TEST(LockedHash_swiss, lockStripes) {
+  SwissHash sized(1000);
+  ASSERT_EQ(8, sized.lock_stripes());
+  SwissHash hash(1000, 0, 3);
+  ASSERT_EQ(4, hash.lock_stripes());
+  ASSERT_EQ(4, hash.bucket_count());
+  test_insert(&hash, 0, 5000);
+  ASSERT_EQ(5000, hash.size());
+  ASSERT_GE(hash.capacity(), 5000);
+  ASSERT_EQ(hash("k_4999")->name, "k_4999");
+}
+
+TEST(LockedHash_swiss, recursiveLock) {
+  SwissHash hash(3);
+  hash(TestClass("A1"));
+  if (auto a = hash.access("A1")) {
+    a->value = 1;
+    // shard locks are recursive
+    ASSERT_EQ(hash("A1")->value, 1);
+  } else {
+    FAIL();
+  }
+}
+
+TEST(LockedHash_swiss, fullInCallback) {
+  SwissHash hash(16, 0, 1);
+  hash(TestClass("A"));
+  size_t capacity = hash.capacity();
+  size_t inserted = 1;
+  string dropped;
+  hash.find("A", [&](TestClass &) {
+    // the shard can not grow under find: inserts stop once it is full
+    for (size_t i = 0; i < capacity * 2 && dropped.empty(); i++) {
+      string key = "k_" + to_string(i);
+      LockedHashOutcome o = hash.compute(
+          key, [&key](LockedHashEntry<TestClass> &e) { e.emplace(key); });
+      if (o == LockedHashOutcome::full) {
+        dropped = key;
+      } else {
+        ASSERT_EQ(o, LockedHashOutcome::inserted);
+        inserted++;
+      }
+    }
+    ASSERT_FALSE(hash(TestClass(dropped)).has_value());
+  });
+  ASSERT_FALSE(dropped.empty());
+  ASSERT_EQ(inserted, hash.size());
+  ASSERT_FALSE(hash(dropped).has_value());
+  // outside the callback the shard makes room
+  ASSERT_EQ(hash(TestClass(dropped))->name, dropped);
+}